@@ -2,24 +2,43 @@ INCLUDEPATH += $$PWD/include
 
 SOURCES += \
         $$PWD/src/context.cpp \
+        $$PWD/src/courtDetector.cpp \
         $$PWD/src/drawable.cpp \
+        $$PWD/src/drawableStore.cpp \
         $$PWD/src/drawables/circle.cpp \
         $$PWD/src/drawables/image.cpp \
         $$PWD/src/drawables/line.cpp \
+        $$PWD/src/drawables/markerSet.cpp \
         $$PWD/src/drawables/rectangle.cpp \
+        $$PWD/src/drawables/sceneView.cpp \
+        $$PWD/src/framePipeline.cpp \
         $$PWD/src/homography.cpp \
+        $$PWD/src/homographyTracker.cpp \
+        $$PWD/src/multiViewRenderer.cpp \
         $$PWD/src/pointManager.cpp \
+        $$PWD/src/profiler.cpp \
         $$PWD/src/renderer.cpp \
-        $$PWD/src/utils.cpp
+        $$PWD/src/utils.cpp \
+        $$PWD/src/worldScene.cpp
 
 HEADERS += \
+        $$PWD/include/boundedQueue.hpp \
         $$PWD/include/context.hpp \
+        $$PWD/include/courtDetector.hpp \
         $$PWD/include/drawable.hpp \
+        $$PWD/include/drawableStore.hpp \
         $$PWD/include/drawables/circle.hpp \
         $$PWD/include/drawables/image.hpp \
         $$PWD/include/drawables/line.hpp \
+        $$PWD/include/drawables/markerSet.hpp \
         $$PWD/include/drawables/rectangle.hpp \
+        $$PWD/include/drawables/sceneView.hpp \
+        $$PWD/include/framePipeline.hpp \
         $$PWD/include/homography.hpp \
+        $$PWD/include/homographyTracker.hpp \
+        $$PWD/include/multiViewRenderer.hpp \
         $$PWD/include/pointManager.hpp \
+        $$PWD/include/profiler.hpp \
         $$PWD/include/renderer.hpp \
-        $$PWD/include/utils.hpp
+        $$PWD/include/utils.hpp \
+        $$PWD/include/worldScene.hpp
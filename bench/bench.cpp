@@ -0,0 +1,1226 @@
+
+#include "courtDetector.hpp"
+#include "drawables/circle.hpp"
+#include "drawables/image.hpp"
+#include "drawables/line.hpp"
+#include "drawables/markerSet.hpp"
+#include "drawables/rectangle.hpp"
+#include "homography.hpp"
+#include "homographyTracker.hpp"
+#include "multiViewRenderer.hpp"
+#include "pointManager.hpp"
+#include "renderer.hpp"
+#include "utils.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Self-contained benchmark harness of the library. Every scenario runs on
+// synthetic inputs generated at startup, timings are printed to stderr and
+// written as JSON to stdout (or to the file given by --output).
+//
+// Usage: bench [--filter <substring>] [--min-time <seconds>] [--min-iterations <count>] [--output <file>]
+
+namespace {
+
+struct Options {
+
+    std::string filter;
+
+    std::string output;
+
+    double minTime = 0.5;
+
+    int minIterations = 5;
+
+    int maxIterations = 1000;
+
+};
+
+struct Result {
+
+    std::string name;
+
+    std::vector<double> samples;
+
+    std::vector<std::pair<std::string, double>> counters;
+
+};
+
+struct Resolution {
+
+    const char* name;
+
+    cv::Size size;
+
+};
+
+const Resolution resolutions[] {
+
+    { "720p", { 1280, 720 } },
+    { "1080p", { 1920, 1080 } },
+    { "4K", { 3840, 2160 } }
+
+};
+
+class Harness {
+
+    public:
+
+        explicit Harness(Options options)
+            : m_options { std::move(options) }
+        {
+        }
+
+        /// \returns true if the benchmark with given name passes the filter.
+        bool isEnabled(const std::string& name) const {
+
+            return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+
+        }
+
+        /// Runs the function until both minimal time and minimal number of iterations are reached.
+        /// \returns median time in milliseconds, zero if the benchmark is filtered out.
+        template<typename Function>
+        double run(const std::string& name, Function function, std::vector<std::pair<std::string, double>> counters = {}) {
+
+            if (!isEnabled(name))
+                return 0.0;
+
+            // Warm up caches and lazily computed state.
+            function();
+
+            Result result { name, {}, std::move(counters) };
+
+            double total = 0.0;
+
+            while (static_cast<int>(result.samples.size()) < m_options.maxIterations
+                   && (static_cast<int>(result.samples.size()) < m_options.minIterations || total < m_options.minTime)) {
+
+                int64 start = cv::getTickCount();
+
+                function();
+
+                double elapsed = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+                result.samples.push_back(elapsed * 1000.0);
+                total += elapsed;
+
+            }
+
+            std::vector<double> sorted = result.samples;
+
+            std::sort(sorted.begin(), sorted.end());
+
+            std::cerr << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(12) << sorted[sorted.size() / 2] << " ms"
+                      << std::setw(8) << sorted.size() << " iterations" << std::endl;
+
+            m_results.push_back(std::move(result));
+
+            return sorted[sorted.size() / 2];
+
+        }
+
+        /// Adds counter to results of the benchmark with given name, which has already run.
+        void addCounter(const std::string& name, const std::string& counter, double value) {
+
+            for (Result& result : m_results)
+                if (result.name == name)
+                    result.counters.emplace_back(counter, value);
+
+        }
+
+        /// Writes all results as JSON.
+        void write(std::ostream& stream) const {
+
+            stream << "{\n"
+                   << "  \"context\": {\n"
+                   << "    \"opencv_version\": \"" << CV_VERSION << "\",\n"
+                   << "    \"threads\": " << cv::getNumThreads() << ",\n"
+#if defined(__AVX2__)
+                   << "    \"avx2\": true,\n"
+#else
+                   << "    \"avx2\": false,\n"
+#endif
+                   << "    \"time_unit\": \"ms\"\n"
+                   << "  },\n"
+                   << "  \"benchmarks\": [";
+
+            for (std::size_t i = 0; i < m_results.size(); i++) {
+
+                const Result& result = m_results[i];
+
+                std::vector<double> sorted = result.samples;
+
+                std::sort(sorted.begin(), sorted.end());
+
+                double mean = 0.0;
+
+                for (double sample : sorted)
+                    mean += sample;
+
+                mean /= sorted.size();
+
+                double variance = 0.0;
+
+                for (double sample : sorted)
+                    variance += (sample - mean) * (sample - mean);
+
+                variance /= sorted.size();
+
+                stream << (i ? ",\n" : "\n")
+                       << "    {\n"
+                       << "      \"name\": \"" << result.name << "\",\n"
+                       << "      \"iterations\": " << sorted.size() << ",\n"
+                       << std::setprecision(6)
+                       << "      \"mean\": " << mean << ",\n"
+                       << "      \"median\": " << sorted[sorted.size() / 2] << ",\n"
+                       << "      \"min\": " << sorted.front() << ",\n"
+                       << "      \"max\": " << sorted.back() << ",\n"
+                       << "      \"stddev\": " << std::sqrt(variance);
+
+                for (const auto& counter : result.counters)
+                    stream << ",\n      \"" << counter.first << "\": " << counter.second;
+
+                stream << "\n    }";
+
+            }
+
+            stream << "\n  ]\n}\n";
+
+        }
+
+    private:
+
+        Options m_options;
+
+        std::vector<Result> m_results;
+
+};
+
+// Synthetic badminton court captured by a camera, shared by all scenarios of one resolution.
+struct Scene {
+
+    cv::Mat frame;
+
+    std::unique_ptr<PointManager> pointManager;
+
+    std::shared_ptr<Homography> homography;
+
+    cv::Mat cameraMatrix;
+
+};
+
+// Transforms point from mapping plane into the frame.
+cv::Point2f toFrame(const Scene& scene, cv::Point2f point) {
+
+    std::vector<cv::Point2f> points { point };
+
+    cv::perspectiveTransform(points, points, scene.cameraMatrix);
+
+    return points[0];
+
+}
+
+Scene createScene(const cv::Size& size) {
+
+    Scene scene;
+
+    const cv::Point2f scale { 50.0f, 50.0f };
+    const cv::Point2f offset { 50.0f, 50.0f };
+
+    scene.pointManager = PointManager::createForBadminton(scale, offset);
+
+    const std::vector<cv::Point2f>& mappingPoints = scene.pointManager->getMappingPoints();
+    const cv::Size& windowSize = scene.pointManager->getWindowSize();
+
+    // Court lines connect mapping points lying on the same row or column.
+    cv::Mat field(windowSize.height + static_cast<int>(offset.y), windowSize.width + static_cast<int>(offset.x), CV_8UC3, { 40.0, 120.0, 40.0 });
+
+    for (std::size_t i = 0; i < mappingPoints.size(); i++)
+        for (std::size_t j = i + 1; j < mappingPoints.size(); j++)
+            if (mappingPoints[i].x == mappingPoints[j].x || mappingPoints[i].y == mappingPoints[j].y)
+                cv::line(field, mappingPoints[i], mappingPoints[j], { 255.0, 255.0, 255.0 }, 3, cv::LINE_AA);
+
+    const cv::Point2f court[] {
+
+        { offset.x, offset.y },
+        { static_cast<float>(windowSize.width), offset.y },
+        { static_cast<float>(windowSize.width), static_cast<float>(windowSize.height) },
+        { offset.x, static_cast<float>(windowSize.height) }
+
+    };
+
+    const cv::Point2f projected[] {
+
+        { 0.3f * size.width, 0.35f * size.height },
+        { 0.7f * size.width, 0.35f * size.height },
+        { 0.9f * size.width, 0.85f * size.height },
+        { 0.1f * size.width, 0.85f * size.height }
+
+    };
+
+    scene.cameraMatrix = cv::getPerspectiveTransform(court, projected);
+
+    cv::warpPerspective(field, scene.frame, scene.cameraMatrix, size, cv::INTER_LINEAR, cv::BORDER_CONSTANT, { 60.0, 60.0, 60.0 });
+
+    cv::Mat noise(size, CV_16SC3);
+
+    cv::randn(noise, cv::Scalar::all(0.0), cv::Scalar::all(8.0));
+
+    cv::add(scene.frame, noise, scene.frame, cv::noArray(), CV_8U);
+
+    // User points are placed slightly off the court corners, as if they were clicked by user.
+    for (std::size_t i = 0; i < mappingPoints.size(); i += 4)
+        scene.pointManager->addUserPoint(toFrame(scene, mappingPoints[i]) + cv::Point2f(1.5f, -1.0f), mappingPoints[i]);
+
+    scene.homography = std::make_shared<Homography>(*scene.pointManager);
+
+    return scene;
+
+}
+
+// Creates image with alpha channel, that is used by Image drawables.
+cv::Mat createLogo() {
+
+    cv::Mat logo(128, 128, CV_8UC4, { 0.0, 0.0, 0.0, 0.0 });
+
+    cv::circle(logo, { 64, 64 }, 60, { 0.0, 200.0, 255.0, 255.0 }, cv::FILLED, cv::LINE_AA);
+    cv::putText(logo, "ICL", { 22, 80 }, cv::FONT_HERSHEY_SIMPLEX, 1.4, { 40.0, 40.0, 40.0, 255.0 }, 3, cv::LINE_AA);
+
+    return logo;
+
+}
+
+// Creates an overlay, where most of the pixels are transparent.
+cv::Mat createOverlay(const cv::Size& size) {
+
+    cv::Mat overlay(size, CV_8UC4, { 255, 255, 255, 0 });
+
+    cv::RNG rng(0x1234);
+
+    for (int i = 0; i < 200; i++) {
+
+        cv::Point from(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        cv::Point to(rng.uniform(0, size.width), rng.uniform(0, size.height));
+
+        cv::line(overlay, from, to, { 0.0, 0.0, 255.0, static_cast<double>(rng.uniform(1, 256)) }, 3, cv::LINE_AA);
+
+    }
+
+    cv::rectangle(overlay, { size.width / 10, size.height / 10 }, { size.width / 3, size.height / 4 }, { 255.0, 0.0, 0.0, 128.0 }, cv::FILLED);
+
+    return overlay;
+
+}
+
+// Reference implementation of blendImages, used to verify the output of the current implementation.
+void blendImagesReference(cv::Mat destinationImage, cv::Mat sourceImage) {
+
+    for (int x = 0; x < destinationImage.cols; x++)
+        for (int y = 0; y < destinationImage.rows; y++) {
+            auto& destination = destinationImage.at<cv::Vec4b>(y, x);
+            auto& source = sourceImage.at<cv::Vec4b>(y, x);
+
+            float alpha = source[3] / 255.0f;
+
+            for (int i = 0; i < 4; i++)
+                destination[i] = static_cast<uchar>((1.0 - alpha) * destination[i] + alpha * source[i]);
+        }
+
+}
+
+enum class DrawableType {
+
+    Circle, Rectangle, Line, Image
+
+};
+
+struct DrawableScenario {
+
+    const char* name;
+
+    DrawableType type;
+
+    int count;
+
+};
+
+const DrawableScenario drawableScenarios[] {
+
+    { "circles", DrawableType::Circle, 200 },
+    { "rectangles", DrawableType::Rectangle, 200 },
+    { "lines", DrawableType::Line, 50 },
+    { "images", DrawableType::Image, 20 }
+
+};
+
+// Fills renderer with drawables placed randomly on the court.
+void populate(Renderer& renderer, const Scene& scene, const DrawableScenario& scenario, cv::Mat logo) {
+
+    cv::RNG rng(0xC0FFEE);
+
+    const cv::Size& windowSize = scene.pointManager->getWindowSize();
+    const cv::Point2f offset = scene.pointManager->getOffset();
+
+    auto randomPoint = [&]() {
+
+        return cv::Point2f(rng.uniform(offset.x, static_cast<float>(windowSize.width))
+                         , rng.uniform(offset.y, static_cast<float>(windowSize.height)));
+
+    };
+
+    for (int i = 0; i < scenario.count; i++) {
+
+        cv::Point2f point = randomPoint();
+        cv::Point2f extent(rng.uniform(10.0f, 60.0f), rng.uniform(10.0f, 60.0f));
+
+        std::unique_ptr<Drawable> drawable;
+
+        switch (scenario.type) {
+
+            case DrawableType::Circle:
+
+                drawable = Circle::create(scene.homography, toFrame(scene, point), rng.uniform(5, 40));
+                break;
+
+            case DrawableType::Rectangle:
+
+                drawable = Rectangle::create(scene.homography, Rectangle::Type::Rectangle, toFrame(scene, point), toFrame(scene, point + extent));
+                break;
+
+            case DrawableType::Line:
+
+                drawable = Line::create(scene.homography, i % 2 ? Line::Type::Vertical : Line::Type::Horizontal
+                                      , toFrame(scene, point), windowSize, offset.x);
+                break;
+
+            case DrawableType::Image:
+
+                drawable = Image::create(scene.homography, toFrame(scene, point), toFrame(scene, point + cv::Point2f(60.0f, 60.0f)), logo);
+                break;
+
+        }
+
+        drawable->setColor({ static_cast<double>(rng.uniform(0, 256)), static_cast<double>(rng.uniform(0, 256)), static_cast<double>(rng.uniform(0, 256)) });
+        drawable->setThickness(rng.uniform(1, 5));
+
+        renderer.addDrawable(std::move(drawable));
+
+    }
+
+}
+
+// Counters of a rendered frame, timings of stages are present only if the library is compiled with profiling.
+std::vector<std::pair<std::string, double>> getFrameCounters(const Renderer& renderer) {
+
+    const Renderer::Stats stats = renderer.getStats();
+
+    std::vector<std::pair<std::string, double>> counters { { "frame_buffer_allocations", static_cast<double>(stats.allocations.frameAllocationCount) } };
+
+    for (const Renderer::StageStats& stage : stats.stages)
+        counters.emplace_back(std::string(stage.name) + "_ms", stage.milliseconds);
+
+    return counters;
+
+}
+
+// Output of incremental and parallel rendering has to match the full serial rendering exactly.
+void checkDifference(const std::string& name, double difference, int& status) {
+
+    if (difference != 0.0) {
+        std::cerr << name << ": output differs from full serial rendering by " << difference << std::endl;
+        status = EXIT_FAILURE;
+    }
+
+}
+
+void benchmarkRender(Harness& harness, const Scene& scene, const Resolution& resolution, int& status) {
+
+    cv::Mat logo = createLogo();
+
+    for (const DrawableScenario& scenario : drawableScenarios) {
+
+        const std::string prefix = std::string("render/") + scenario.name + "/" + std::to_string(scenario.count) + "/" + resolution.name;
+
+        if (!harness.isEnabled(prefix))
+            continue;
+
+        Renderer renderer;
+
+        renderer.setBackgroundImage(scene.frame);
+
+        populate(renderer, scene, scenario, logo);
+
+        // Geometry of drawables is cached, only rasterization and blending are measured.
+        // Frame buffers are allocated by the first frame, following frames should not allocate them.
+        renderer.render();
+        renderer.render();
+
+        const double serialTime = harness.run(prefix + "/static", [&]() { renderer.render(); }, getFrameCounters(renderer));
+
+        // Tiles are rendered on multiple threads, output is compared with the serial rendering.
+        renderer.render();
+
+        cv::Mat serial = renderer.getOutputImage().clone();
+
+        renderer.setParallelRendering(true);
+        renderer.render();
+
+        double difference = cv::norm(serial, renderer.getOutputImage(), cv::NORM_INF);
+
+        checkDifference(prefix + "/parallel", difference, status);
+
+        const double parallelTime = harness.run(prefix + "/parallel", [&]() { renderer.render(); }, { { "max_difference", difference } });
+
+        // Drawables spanning several tiles are drawn once, so parallel rendering should not be slower than the serial one.
+        if (serialTime > 0.0 && parallelTime > 0.0) {
+
+            harness.addCounter(prefix + "/parallel", "speedup", serialTime / parallelTime);
+
+            std::cerr << prefix << "/parallel speedup " << std::setprecision(2) << serialTime / parallelTime
+                      << "x on " << cv::getNumThreads() << " threads" << std::endl;
+
+        }
+
+        renderer.setParallelRendering(false);
+
+        // Context stores premultiplied colors, which makes blending of covered tiles cheaper.
+        renderer.setPremultipliedAlpha(true);
+
+        harness.run(prefix + "/premultiplied", [&]() { renderer.render(); });
+
+        renderer.setPremultipliedAlpha(false);
+
+        // Homography changes every frame, so geometry of all drawables is recomputed.
+        harness.run(prefix + "/moving", [&]() {
+
+            scene.homography->setHomographyMatrix(scene.homography->getHomographyMatrix());
+            renderer.render();
+
+        });
+
+        // Drawables are blended directly into a copy of the frame, copying
+        // stands in for decoding of a new frame in both variants.
+        cv::Mat bgr;
+        cv::Mat i420;
+        cv::Mat i420Source;
+
+        cv::cvtColor(scene.frame, i420Source, cv::COLOR_BGR2YUV_I420);
+
+        harness.run(prefix + "/onto_bgr", [&]() {
+
+            scene.frame.copyTo(bgr);
+            renderer.renderOnto(bgr);
+
+        });
+
+        harness.run(prefix + "/onto_i420", [&]() {
+
+            i420Source.copyTo(i420);
+            renderer.renderOnto(i420, Renderer::FrameFormat::I420);
+
+        });
+
+        // Reference for the variants above, frame is converted and set as background image.
+        harness.run(prefix + "/background", [&]() {
+
+            renderer.setBackgroundImage(scene.frame);
+            renderer.render();
+
+        });
+
+        // Single drawable changes every frame and only its region is rendered.
+        renderer.setDamageTracking(true);
+
+        int frame = 0;
+
+        harness.run(prefix + "/damage", [&]() {
+
+            Drawable* drawable = renderer.getDrawables()[frame % renderer.getDrawables().size()].get();
+
+            drawable->setColor(frame % 2 ? cv::Scalar(0.0, 0.0, 255.0) : cv::Scalar(255.0, 0.0, 0.0));
+            renderer.render();
+
+            frame++;
+
+        });
+
+        // Drawables crossing the damaged region are redrawn only inside of it.
+        cv::Mat damaged = renderer.getOutputImage().clone();
+
+        renderer.setDamageTracking(false);
+        renderer.render();
+
+        checkDifference(prefix + "/damage", cv::norm(damaged, renderer.getOutputImage(), cv::NORM_INF), status);
+
+    }
+
+}
+
+// Compares single MarkerSet with the same markers drawn as separate circles.
+void benchmarkMarkers(Harness& harness, const Scene& scene, const Resolution& resolution) {
+
+    constexpr int markerCount = 2000;
+
+    const std::string prefix = std::string("render/markers/") + std::to_string(markerCount) + "/" + resolution.name;
+
+    if (!harness.isEnabled(prefix))
+        return;
+
+    cv::RNG rng(0xC0FFEE);
+
+    const cv::Size& windowSize = scene.pointManager->getWindowSize();
+    const cv::Point2f offset = scene.pointManager->getOffset();
+
+    std::vector<cv::Point2f> positions(markerCount);
+    std::vector<float> radii(markerCount);
+    std::vector<cv::Vec3b> colors(markerCount);
+
+    // Markers are coloured by team, as players of a few teams would be.
+    const cv::Vec3b teamColors[] { { 0, 0, 255 }, { 255, 0, 0 }, { 0, 255, 255 }, { 255, 255, 255 } };
+
+    for (int i = 0; i < markerCount; i++) {
+
+        positions[i] = toFrame(scene, { rng.uniform(offset.x, static_cast<float>(windowSize.width)), rng.uniform(offset.y, static_cast<float>(windowSize.height)) });
+        radii[i] = rng.uniform(5.0f, 15.0f);
+        colors[i] = teamColors[i % 4];
+
+    }
+
+    Renderer circleRenderer;
+
+    circleRenderer.setBackgroundImage(scene.frame);
+
+    for (int i = 0; i < markerCount; i++) {
+
+        auto circle = Circle::create(scene.homography, positions[i], static_cast<int>(std::lround(radii[i])));
+
+        circle->setColor({ static_cast<double>(colors[i][0]), static_cast<double>(colors[i][1]), static_cast<double>(colors[i][2]) });
+        circle->setThickness(2);
+
+        circleRenderer.addDrawable(std::move(circle));
+
+    }
+
+    Renderer markerRenderer;
+
+    markerRenderer.setBackgroundImage(scene.frame);
+
+    auto markerSet = MarkerSet::create(scene.homography, positions, 1.0f);
+
+    // Radii are rounded the same way as radii of the circles.
+    std::vector<float> roundedRadii(markerCount);
+
+    std::transform(radii.begin(), radii.end(), roundedRadii.begin(), [](float radius) { return std::round(radius); });
+
+    markerSet->setRadii(roundedRadii.data(), roundedRadii.size());
+    markerSet->setColors(colors.data(), colors.size());
+    markerSet->setThickness(2);
+
+    MarkerSet* markers = markerSet.get();
+
+    markerRenderer.addDrawable(std::move(markerSet));
+
+    circleRenderer.render();
+    markerRenderer.render();
+
+    double difference = cv::norm(circleRenderer.getOutputImage(), markerRenderer.getOutputImage(), cv::NORM_L1) / circleRenderer.getOutputImage().total();
+
+    harness.run(prefix + "/circles", [&]() { circleRenderer.render(); }, getFrameCounters(circleRenderer));
+    harness.run(prefix + "/marker_set", [&]() { markerRenderer.render(); }, { { "mean_difference", difference } });
+
+    // Tracker moves all markers every frame, positions of the marker set are replaced by a single copy.
+    std::vector<cv::Point2f> moved(positions);
+
+    int frame = 0;
+
+    harness.run(prefix + "/circles_moving", [&]() {
+
+        const cv::Point2f shift(frame % 2 ? 1.0f : -1.0f, 0.0f);
+
+        for (std::size_t i = 0; i < circleRenderer.getDrawables().size(); i++)
+            static_cast<Circle*>(circleRenderer.getDrawables()[i].get())->setPoint(positions[i] + shift);
+
+        circleRenderer.render();
+
+        frame++;
+
+    });
+
+    harness.run(prefix + "/marker_set_moving", [&]() {
+
+        const cv::Point2f shift(frame % 2 ? 1.0f : -1.0f, 0.0f);
+
+        for (std::size_t i = 0; i < moved.size(); i++)
+            moved[i] = positions[i] + shift;
+
+        markers->setPositions(moved);
+        markerRenderer.render();
+
+        frame++;
+
+    });
+
+}
+
+// Static overlay with a few moving markers, rendered in a single layer and with the overlay in a static layer.
+void benchmarkLayers(Harness& harness, const Scene& scene, const Resolution& resolution, int& status) {
+
+    const std::string prefix = std::string("render/layers/") + resolution.name;
+
+    if (!harness.isEnabled(prefix))
+        return;
+
+    cv::Mat logo = createLogo();
+
+    const cv::Size& windowSize = scene.pointManager->getWindowSize();
+    const cv::Point2f offset = scene.pointManager->getOffset();
+
+    std::vector<cv::Point2f> positions;
+
+    cv::RNG rng(0xC0FFEE);
+
+    for (int i = 0; i < 50; i++)
+        positions.push_back(toFrame(scene, { rng.uniform(offset.x, static_cast<float>(windowSize.width)), rng.uniform(offset.y, static_cast<float>(windowSize.height)) }));
+
+    auto populateLayers = [&](Renderer& renderer, const std::string& staticLayer) {
+
+        cv::RNG overlayRng(0x1234);
+
+        for (int i = 0; i < 200; i++) {
+
+            const cv::Point2f point(overlayRng.uniform(offset.x, static_cast<float>(windowSize.width)), overlayRng.uniform(offset.y, static_cast<float>(windowSize.height)));
+
+            auto rectangle = Rectangle::create(scene.homography, Rectangle::Type::Rectangle, toFrame(scene, point), toFrame(scene, point + cv::Point2f(40.0f, 20.0f)));
+
+            rectangle->setColor({ 255.0, 255.0, 255.0 });
+            rectangle->setThickness(2);
+
+            renderer.insertDrawable(std::move(rectangle), staticLayer);
+
+        }
+
+        for (int i = 0; i < 10; i++) {
+
+            const cv::Point2f point(offset.x + i * 60.0f, offset.y);
+
+            renderer.insertDrawable(Image::create(scene.homography, toFrame(scene, point), toFrame(scene, point + cv::Point2f(50.0f, 50.0f)), logo), staticLayer);
+
+        }
+
+        auto markers = MarkerSet::create(scene.homography, positions, 8.0f);
+
+        markers->setColor({ 0.0, 0.0, 255.0 });
+        markers->setThickness(-1);
+
+        MarkerSet* markerSet = markers.get();
+
+        renderer.insertDrawable(std::move(markers));
+
+        return markerSet;
+
+    };
+
+    Renderer singleRenderer;
+    Renderer layeredRenderer;
+
+    singleRenderer.setBackgroundImage(scene.frame);
+    layeredRenderer.setBackgroundImage(scene.frame);
+
+    layeredRenderer.addLayer("court", -1, true);
+
+    MarkerSet* singleMarkers = populateLayers(singleRenderer, Renderer::defaultLayerName);
+    MarkerSet* layeredMarkers = populateLayers(layeredRenderer, "court");
+
+    singleRenderer.render();
+    layeredRenderer.render();
+
+    double difference = cv::norm(singleRenderer.getOutputImage(), layeredRenderer.getOutputImage(), cv::NORM_INF);
+
+    // Markers move every frame, rest of the overlay does not change.
+    std::vector<cv::Point2f> moved(positions);
+
+    int frame = 0;
+
+    auto moveMarkers = [&](MarkerSet* markers) {
+
+        const cv::Point2f shift(static_cast<float>(frame % 8), 0.0f);
+
+        for (std::size_t i = 0; i < moved.size(); i++)
+            moved[i] = positions[i] + shift;
+
+        markers->setPositions(moved);
+
+        frame++;
+
+    };
+
+    harness.run(prefix + "/single", [&]() { moveMarkers(singleMarkers); singleRenderer.render(); }, getFrameCounters(singleRenderer));
+
+    // Only regions of moved markers are rendered, the rest of the frame is reused.
+    singleRenderer.setDamageTracking(true);
+
+    harness.run(prefix + "/damage", [&]() { moveMarkers(singleMarkers); singleRenderer.render(); });
+
+    cv::Mat damaged = singleRenderer.getOutputImage().clone();
+
+    singleRenderer.setDamageTracking(false);
+    singleRenderer.render();
+
+    checkDifference(prefix + "/damage", cv::norm(damaged, singleRenderer.getOutputImage(), cv::NORM_INF), status);
+    checkDifference(prefix + "/static", difference, status);
+
+    harness.run(prefix + "/static", [&]() { moveMarkers(layeredMarkers); layeredRenderer.render(); }, { { "max_difference", difference } });
+
+    // Rectangle of the static layer changes, so the cached layer is drawn again only around it.
+    for (Renderer* renderer : { &singleRenderer, &layeredRenderer })
+        renderer->getDrawables().front()->setThickness(5);
+
+    singleMarkers->setPositions(positions);
+    layeredMarkers->setPositions(positions);
+
+    singleRenderer.render();
+    layeredRenderer.render();
+
+    checkDifference(prefix + "/static", cv::norm(singleRenderer.getOutputImage(), layeredRenderer.getOutputImage(), cv::NORM_INF), status);
+
+}
+
+// Cameras watching the same court, drawn either with drawables duplicated for every camera or with one shared scene.
+void benchmarkMultiView(Harness& harness, const Scene& scene, const Resolution& resolution) {
+
+    const std::string prefix = std::string("render/multiView/") + resolution.name;
+
+    if (!harness.isEnabled(prefix))
+        return;
+
+    constexpr int viewCount = 8;
+    constexpr int markerCount = 60;
+    constexpr int markerRadius = 8;
+
+    const cv::Size& windowSize = scene.pointManager->getWindowSize();
+    const cv::Point2f offset = scene.pointManager->getOffset();
+
+    // Every camera sees the court shifted by a few pixels.
+    std::vector<std::shared_ptr<Homography>> homographies;
+
+    for (int i = 0; i < viewCount; i++) {
+
+        const cv::Matx33d shift(1.0, 0.0, -4.0 * i, 0.0, 1.0, -2.0 * i, 0.0, 0.0, 1.0);
+
+        auto homography = std::make_shared<Homography>();
+
+        homography->setHomographyMatrix(cv::Mat(scene.homography->getMatrix() * shift));
+        homographies.push_back(homography);
+
+    }
+
+    std::vector<cv::Point2f> positions;
+
+    cv::RNG rng(0xC0FFEE);
+
+    for (int i = 0; i < markerCount; i++)
+        positions.push_back({ rng.uniform(offset.x, static_cast<float>(windowSize.width)), rng.uniform(offset.y, static_cast<float>(windowSize.height)) });
+
+    std::vector<cv::Point2f> moved(positions);
+
+    int frame = 0;
+
+    auto moveMarkers = [&]() {
+
+        const cv::Point2f shift(static_cast<float>(frame % 8), 0.0f);
+
+        for (std::size_t i = 0; i < moved.size(); i++)
+            moved[i] = positions[i] + shift;
+
+        frame++;
+
+    };
+
+    std::vector<std::unique_ptr<Renderer>> duplicatedRenderers;
+    std::vector<std::vector<Circle*>> duplicatedCircles(viewCount);
+    std::vector<cv::Point2f> centers;
+
+    for (int i = 0; i < viewCount; i++) {
+
+        duplicatedRenderers.push_back(std::make_unique<Renderer>());
+        duplicatedRenderers.back()->setBackgroundImage(scene.frame.clone());
+
+        homographies[i]->unproject(positions, centers);
+
+        for (const cv::Point2f& center : centers) {
+
+            auto circle = Circle::create(homographies[i], center, markerRadius);
+
+            circle->setColor({ 0.0, 0.0, 255.0 });
+            circle->setThickness(2);
+
+            duplicatedCircles[i].push_back(circle.get());
+            duplicatedRenderers.back()->addDrawable(std::move(circle));
+
+        }
+
+    }
+
+    auto worldScene = std::make_shared<WorldScene>();
+
+    for (const cv::Point2f& position : positions)
+        worldScene->addCircle(position, static_cast<float>(markerRadius), { 0.0, 0.0, 255.0 }, 2);
+
+    MultiViewRenderer multiViewRenderer;
+
+    for (int i = 0; i < viewCount; i++) {
+
+        multiViewRenderer.addView(homographies[i]);
+        multiViewRenderer.getRenderer(i).setBackgroundImage(scene.frame.clone());
+
+    }
+
+    multiViewRenderer.addScene(worldScene);
+
+    auto renderDuplicated = [&]() {
+
+        for (int i = 0; i < viewCount; i++) {
+
+            homographies[i]->unproject(moved, centers);
+
+            for (std::size_t j = 0; j < centers.size(); j++)
+                duplicatedCircles[i][j]->setPoint(centers[j]);
+
+        }
+
+        cv::parallel_for_(cv::Range(0, viewCount), [&](const cv::Range& range) {
+
+            for (int i = range.start; i < range.end; i++)
+                duplicatedRenderers[i]->render();
+
+        });
+
+    };
+
+    auto renderShared = [&]() {
+
+        worldScene->setPositions(moved.data(), moved.size());
+        multiViewRenderer.render();
+
+    };
+
+    harness.run(prefix + "/duplicated", [&]() { moveMarkers(); renderDuplicated(); });
+    harness.run(prefix + "/shared", [&]() { moveMarkers(); renderShared(); });
+
+}
+
+void benchmarkBlendImages(Harness& harness, const Resolution& resolution, int& status) {
+
+    const std::string name = std::string("blendImages/") + resolution.name;
+
+    if (!harness.isEnabled(name))
+        return;
+
+    cv::Mat background(resolution.size, CV_8UC4);
+
+    cv::randu(background, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    cv::Mat overlay = createOverlay(resolution.size);
+
+    cv::Mat expected = background.clone();
+    cv::Mat actual = background.clone();
+
+    blendImagesReference(expected, overlay);
+    blendImages(actual, overlay);
+
+    double difference = cv::norm(expected, actual, cv::NORM_INF);
+
+    if (difference > 1.0) {
+        std::cerr << name << ": output differs from reference by " << difference << std::endl;
+        status = EXIT_FAILURE;
+    }
+
+    cv::Mat destination = background.clone();
+
+    harness.run(name, [&]() { blendImages(destination, overlay); }, { { "max_difference", difference } });
+
+}
+
+void benchmarkCourtDetection(Harness& harness, const Scene& scene, const Resolution& resolution) {
+
+    const std::string name = std::string("CourtDetector::detect/") + resolution.name;
+
+    if (!harness.isEnabled(name))
+        return;
+
+    CourtDetector detector;
+
+    std::unique_ptr<PointManager> pointManager = PointManager::createForBadminton(scene.pointManager->getScale(), scene.pointManager->getOffset());
+
+    const bool found = detector.detect(scene.frame, *pointManager);
+
+    harness.run(name, [&]() { detector.detect(scene.frame, *pointManager); }
+              , { { "found", found ? 1.0 : 0.0 }, { "score", detector.getScore() }, { "points", static_cast<double>(pointManager->getUserPointCount()) } });
+
+}
+
+void benchmarkTracking(Harness& harness, const Scene& scene, const Resolution& resolution) {
+
+    const std::string name = std::string("HomographyTracker::track/") + resolution.name;
+
+    if (!harness.isEnabled(name))
+        return;
+
+    // Camera pans slowly to the left and back, frames are shifted copies of the scene.
+    constexpr int frameCount = 16;
+
+    std::vector<cv::Mat> frames(frameCount);
+
+    for (int i = 0; i < frameCount; i++)
+        cv::warpAffine(scene.frame, frames[i], cv::Matx23d(1.0, 0.0, -2.0 * i, 0.0, 1.0, 0.5 * i), scene.frame.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+
+    std::shared_ptr<Homography> homography = std::make_shared<Homography>();
+
+    HomographyTracker tracker(homography);
+
+    tracker.initialize(frames[0], *scene.pointManager);
+
+    int index = 0;
+
+    harness.run(name, [&]() {
+
+        index = (index + 1) % (2 * frameCount - 2);
+
+        if (!tracker.track(frames[index < frameCount ? index : 2 * frameCount - 2 - index])) {
+            tracker.initialize(frames[0], *scene.pointManager);
+            index = 0;
+        }
+
+    }, { { "features", static_cast<double>(tracker.getFeatureCount()) } });
+
+}
+
+void benchmarkImageFunctions(Harness& harness, const Scene& scene, const Resolution& resolution) {
+
+    cv::Mat output;
+
+    harness.run(std::string("undistort/") + resolution.name, [&]() { undistort(scene.frame, output, -0.25, 1.1); });
+
+    harness.run(std::string("computeBirdsEyeView/") + resolution.name, [&]() {
+
+        output = computeBirdsEyeView(*scene.homography, scene.frame, scene.pointManager->getWindowSize());
+
+    });
+
+    const std::vector<cv::Point2f> imagePoints = scene.pointManager->getUserImagePoints();
+    const std::vector<PointManager::UserPointId> ids = scene.pointManager->getUserPointIds();
+
+    harness.run(std::string("improvePoints/") + resolution.name, [&]() {
+
+        scene.pointManager->improvePoints(scene.frame);
+
+        // Points are restored every iteration, so each run starts from the same position.
+        for (std::size_t i = 0; i < ids.size(); i++)
+            scene.pointManager->setUserImagePoint(ids[i], imagePoints[i]);
+
+    });
+
+}
+
+// Editors add and remove many annotations per frame, management of drawables is measured without rendering.
+void benchmarkDrawableStore(Harness& harness, const Scene& scene, int& status) {
+
+    constexpr int drawableCount = 2000;
+    constexpr int changedCount = 200;
+
+    Renderer renderer;
+
+    std::vector<DrawableHandle> handles;
+
+    for (int i = 0; i < drawableCount; i++)
+        handles.push_back(renderer.insertDrawable(Circle::create(scene.homography, { 100.0f, 100.0f }, 10)));
+
+    cv::RNG rng(0xC0FFEE);
+
+    std::size_t changeCount = 0;
+    std::size_t staleCount = 0;
+
+    harness.run("drawables/churn/" + std::to_string(changedCount) + "_of_" + std::to_string(drawableCount), [&]() {
+
+        for (int i = 0; i < changedCount; i++) {
+
+            DrawableHandle& handle = handles[rng.uniform(0, drawableCount)];
+
+            renderer.removeDrawable(handle);
+
+            // Handle of the removed drawable must not reach the new drawable in its slot.
+            const DrawableHandle stale = handle;
+
+            handle = renderer.insertDrawable(Circle::create(scene.homography, { 100.0f, 100.0f }, 10));
+
+            changeCount++;
+            staleCount += renderer.getDrawable(stale) == nullptr;
+
+        }
+
+        // Draw order is compacted once per frame, as render does.
+        renderer.getDrawables();
+
+    });
+
+    if (staleCount != changeCount) {
+        std::cerr << "drawables/churn: stale handle was not detected" << std::endl;
+        status = EXIT_FAILURE;
+    }
+
+}
+
+void benchmarkHomography(Harness& harness, const Scene& scene) {
+
+    Homography homography;
+
+    harness.run("computeHomographyMatrix", [&]() { homography.computeHomographyMatrix(*scene.pointManager); }
+              , { { "points", static_cast<double>(scene.pointManager->getUserPointCount()) } });
+
+    homography.setMethod(Homography::Method::RANSAC);
+    homography.computeHomographyMatrix(*scene.pointManager);
+
+    harness.run("computeHomographyMatrix/ransac", [&]() { homography.computeHomographyMatrix(*scene.pointManager); }
+              , { { "reprojection_error", homography.getReprojectionError() } });
+
+    homography.setMethod(Homography::Method::USAC);
+    homography.computeHomographyMatrix(*scene.pointManager);
+
+    harness.run("computeHomographyMatrix/usac", [&]() { homography.computeHomographyMatrix(*scene.pointManager); }
+              , { { "reprojection_error", homography.getReprojectionError() } });
+
+    // Interactive editing, a single user point is dragged and the previous estimate is refined.
+    std::unique_ptr<PointManager> editedPoints = PointManager::createCustom();
+
+    PointManager::UserPointId draggedPoint = 0;
+
+    for (std::size_t i = 0; i < scene.pointManager->getUserPointCount(); i++)
+        draggedPoint = editedPoints->addUserPoint(scene.pointManager->getUserImagePoints()[i], scene.pointManager->getUserMappingPoints()[i]);
+
+    const cv::Point2f origin = editedPoints->getUserImagePoints().back();
+
+    int step = 0;
+
+    auto dragPoint = [&]() {
+
+        editedPoints->setUserImagePoint(draggedPoint, origin + cv::Point2f(static_cast<float>(step % 16), static_cast<float>(step % 16) * 0.5f));
+        step++;
+
+    };
+
+    homography.setMethod(Homography::Method::LeastSquares);
+    homography.computeHomographyMatrix(*editedPoints);
+
+    harness.run("refineHomographyMatrix/drag", [&]() { dragPoint(); homography.refineHomographyMatrix(*editedPoints); }
+              , { { "points", static_cast<double>(editedPoints->getUserPointCount()) } });
+
+    harness.run("computeHomographyMatrix/drag", [&]() { dragPoint(); homography.computeHomographyMatrix(*editedPoints); });
+
+    std::vector<cv::Point2f> points(1 << 16);
+
+    cv::RNG rng(42);
+
+    for (cv::Point2f& point : points)
+        point = { rng.uniform(0.0f, 1920.0f), rng.uniform(0.0f, 1080.0f) };
+
+    std::vector<cv::Point2f> output;
+
+    harness.run("Homography::project/65536", [&]() { scene.homography->project(points, output); });
+
+    harness.run("perspectiveTransform/65536", [&]() { cv::perspectiveTransform(points, output, scene.homography->getHomographyMatrix()); });
+
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+
+    for (int i = 1; i < argc; i++) {
+
+        std::string argument = argv[i];
+
+        if (i + 1 >= argc)
+            return false;
+
+        if (argument == "--filter") {
+            options.filter = argv[++i];
+        } else if (argument == "--output") {
+            options.output = argv[++i];
+        } else if (argument == "--min-time") {
+            options.minTime = std::atof(argv[++i]);
+        } else if (argument == "--min-iterations") {
+            options.minIterations = std::max(std::atoi(argv[++i]), 1);
+        } else {
+            return false;
+        }
+
+    }
+
+    return true;
+
+}
+
+}
+
+int main(int argc, char** argv) {
+
+    Options options;
+
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " [--filter <substring>] [--min-time <seconds>] [--min-iterations <count>] [--output <file>]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Harness harness(options);
+
+    int status = EXIT_SUCCESS;
+
+    for (const Resolution& resolution : resolutions) {
+
+        Scene scene = createScene(resolution.size);
+
+        benchmarkRender(harness, scene, resolution, status);
+        benchmarkMarkers(harness, scene, resolution);
+        benchmarkLayers(harness, scene, resolution, status);
+        benchmarkMultiView(harness, scene, resolution);
+        benchmarkBlendImages(harness, resolution, status);
+        benchmarkImageFunctions(harness, scene, resolution);
+        benchmarkCourtDetection(harness, scene, resolution);
+        benchmarkTracking(harness, scene, resolution);
+
+    }
+
+    benchmarkHomography(harness, createScene(resolutions[1].size));
+    benchmarkDrawableStore(harness, createScene(resolutions[1].size), status);
+
+    if (options.output.empty()) {
+
+        harness.write(std::cout);
+
+    } else {
+
+        std::ofstream stream(options.output);
+
+        harness.write(stream);
+
+        if (!stream) {
+            std::cerr << "failed to write " << options.output << std::endl;
+            return EXIT_FAILURE;
+        }
+
+    }
+
+    return status;
+
+}
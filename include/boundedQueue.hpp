@@ -0,0 +1,120 @@
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/// \class BoundedQueue
+/// \brief Thread safe queue with limited capacity.
+///
+/// Class BoundedQueue is used to pass values between
+/// threads. Method push blocks while the queue is full
+/// and method pop blocks while the queue is empty, so
+/// the producer can never get more than capacity values
+/// ahead of the consumer.
+///
+/// Once the queue is closed, push fails immediately and
+/// pop returns remaining values and then fails, which is
+/// used to stop threads waiting on the queue.
+///
+
+template<typename T>
+class BoundedQueue final {
+
+    public:
+
+        /// BoundedQueue constructor.
+        /// \param capacity maximal number of values stored in queue.
+        explicit BoundedQueue(std::size_t capacity)
+            : m_capacity { capacity > 0 ? capacity : 1 }
+        {
+        }
+
+        /// Insert value at the end of queue, blocks while the queue is full.
+        /// \param value inserted value.
+        /// \returns false if the queue was closed.
+        bool push(T value) {
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_notFull.wait(lock, [this]() { return m_closed || m_values.size() < m_capacity; });
+
+            if (m_closed)
+                return false;
+
+            m_values.push_back(std::move(value));
+
+            lock.unlock();
+
+            m_notEmpty.notify_one();
+
+            return true;
+
+        }
+
+        /// Remove value from the beginning of queue, blocks while the queue is empty.
+        /// \param value removed value.
+        /// \returns false if the queue was closed and is empty.
+        bool pop(T& value) {
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_notEmpty.wait(lock, [this]() { return m_closed || !m_values.empty(); });
+
+            if (m_values.empty())
+                return false;
+
+            value = std::move(m_values.front());
+
+            m_values.pop_front();
+
+            lock.unlock();
+
+            m_notFull.notify_one();
+
+            return true;
+
+        }
+
+        /// Close queue and wake up all waiting threads.
+        void close() {
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_closed = true;
+            }
+
+            m_notFull.notify_all();
+            m_notEmpty.notify_all();
+
+        }
+
+        /// Remove all values and open closed queue.
+        void reset() {
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_values.clear();
+            m_closed = false;
+
+        }
+
+    private:
+
+        std::size_t m_capacity;
+
+        std::deque<T> m_values;
+
+        bool m_closed = false;
+
+        std::mutex m_mutex;
+
+        std::condition_variable m_notFull;
+
+        std::condition_variable m_notEmpty;
+
+};
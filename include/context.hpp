@@ -3,6 +3,11 @@
 
 #include <opencv2/opencv.hpp>
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 class Drawable;
 
 /// \class Context
@@ -14,35 +19,140 @@ class Drawable;
 /// containing drawables is then merged with background
 /// image in class Renderer.
 ///
+/// Drawables are allowed to modify only pixels inside the
+/// clip region of the context. By default the clip region
+/// covers the whole context, Renderer restricts it to render
+/// only parts of the context that changed.
+///
+/// Context can also be created as a view of another context,
+/// which shares its image but has its own clip region. Views
+/// with disjoint clip regions can be drawn into concurrently.
+///
+/// View can also draw into a separate image, which is placed over
+/// its clip region. Renderer uses such views to draw into a scratch
+/// image and copies back only the rendered region, because OpenCV
+/// clips shapes to the image they are drawn into and antialiased
+/// edges of clipped shapes differ from the unclipped ones. Coverage
+/// map is not changed by these views.
+///
+/// Context keeps a coverage map, which splits the context into
+/// square tiles and marks tiles modified by drawables. Method
+/// draw marks tiles inside bounding box of the drawn object,
+/// pixels modified in any other way have to be marked by method
+/// markCovered. Only covered tiles are cleared by method clear
+/// and blended with background image by Renderer.
+///
+/// If the context is premultiplied, it is cleared to transparent
+/// black and drawables store color channels multiplied by alpha.
+/// Otherwise it is cleared to transparent white and drawables
+/// store colors unchanged.
+///
 
 class Context {
 
     public:
 
+        /// Size of tiles in coverage map.
+        static constexpr int coverageTileSize = 64;
+
         /// Context constructor.
         /// \param size of new context.
-        explicit Context(cv::Size size);
+        /// \param premultiplied if set to true, context stores colors premultiplied by alpha.
+        explicit Context(cv::Size size, bool premultiplied = false);
+
+        /// Context constructor, which creates view sharing image with other context.
+        /// \param context context, whose image will be shared.
+        /// \param clip region of context, which can be modified by drawables.
+        Context(const Context& context, const cv::Rect& clip);
+
+        /// Context constructor, which creates view drawing into separate image.
+        /// \param context context, whose size and alpha mode are used.
+        /// \param clip region of context, which can be modified by drawables.
+        /// \param image CV_8UC4 image of the size of clip region, which is drawn into instead of context.
+        Context(const Context& context, const cv::Rect& clip, cv::Mat image);
 
         ///Default destructor.
         virtual ~Context() = default;
 
-        /// Method used for erasing all content in context.
+        /// Method used for erasing all content in context, memory of context is reused.
+        /// Only tiles marked in coverage map are erased.
         void clear();
 
-        /// This method is used for drawing drawables.
+        /// Erase content of context inside the region.
+        /// \param region erased region.
+        void clear(const cv::Rect& region);
+
+        /// This method is used for drawing drawables. Tiles inside bounding box of the drawable are marked as covered.
         /// \param drawable instance of drawable.
         void draw(Drawable& drawable);
 
-        /// \returns context.
+        /// Convert color of drawable into value, that is stored in context.
+        /// \param color color of drawable.
+        /// \param alpha transparency of drawable.
+        /// \returns color with alpha channel, premultiplied if the context is premultiplied.
+        cv::Scalar getColor(const cv::Scalar& color, float alpha) const;
+
+        /// Returns tiles of coverage map, that are marked as covered.
+        /// \param region region of context, returned tiles are clipped to this region.
+        /// \returns vector containing covered tiles.
+        std::vector<cv::Rect> getCoveredTiles(const cv::Rect& region) const;
+
+        /// Find tiles of coverage map, that are marked as covered.
+        /// \param region region of context, tiles are clipped to this region.
+        /// \param tiles vector, which is cleared and filled with covered tiles, its memory is reused.
+        void getCoveredTiles(const cv::Rect& region, std::vector<cv::Rect>& tiles) const;
+
+        /// \returns region of context, which can be modified by drawables.
+        const cv::Rect& getClip() const;
+
+        /// \returns part of context inside clip region.
+        cv::Mat getClippedImage() const;
+
+        /// \returns context, for views drawing into separate image only the image of clip region.
         cv::Mat getImage() const;
 
         /// \returns size of context.
         const cv::Size& getSize() const;
 
+        /// \returns true if context stores colors premultiplied by alpha.
+        bool isPremultiplied() const;
+
+        /// Mark tiles of coverage map as covered.
+        /// \param region modified region of context.
+        void markCovered(const cv::Rect& region);
+
+        /// Restrict drawing to region of context.
+        /// \param clip region of context, which can be modified by drawables.
+        void setClip(const cv::Rect& clip);
+
+        /// Allow drawing into the whole context.
+        void resetClip();
+
     private:
 
+        /// \returns value of transparent pixel.
+        cv::Scalar getClearColor() const;
+
+        /// \returns rectangle of tile of coverage map.
+        cv::Rect getTile(int column, int row) const;
+
         cv::Size m_size;
 
         cv::Mat m_image;
 
+        cv::Rect m_clip;
+
+        // Position of the image in context, which differs from origin for views drawing into separate image.
+        cv::Point m_origin;
+
+        bool m_premultiplied;
+
+        int m_coverageColumns;
+
+        int m_coverageRows;
+
+        // Shared by all views of the context, tiles are marked from multiple threads.
+        // Null for views drawing into separate image.
+        std::shared_ptr<std::vector<std::atomic<std::uint8_t>>> m_coverage;
+
 };
@@ -0,0 +1,127 @@
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+
+/// \class CourtDetector
+/// \brief Class to find court in image and place user points automatically.
+///
+/// Class CourtDetector finds lines of a sport field in an image and
+/// places user points of PointManager on the mapping points of the
+/// field, so the user points do not need to be placed by hand.
+///
+/// Image is downscaled and pixels of court lines are extracted as
+/// pixels, which are bright and brighter than pixels in distance of
+/// line width on both sides. Line segments are found in the mask
+/// by Hough transform and merged into lines, which are split into
+/// mostly horizontal and mostly vertical lines. Lines of the field
+/// are derived from mapping points of PointManager, mapping points
+/// with the same x or y coordinate lie on the same line.
+///
+/// Pairs of horizontal and vertical lines in image are matched with
+/// pairs of field lines. Each match defines homography from mapping
+/// plane into image, which is verified by projecting field lines into
+/// image and counting their samples lying on line pixels. Matches
+/// which mirror the field are rejected without verification. The
+/// best homography is refined by intersections of image lines close
+/// to projected mapping points and mapping points projected into the
+/// image are inserted into PointManager as user points. Positions of
+/// the user points can be improved by PointManager::improvePoints.
+///
+/// Number of verified matches depends on number of lines used from
+/// the image, which can be set by setMaxLines.
+///
+
+class PointManager;
+
+class CourtDetector final {
+
+    public:
+
+        /// Find court in image and replace user points of point manager.
+        /// \param image BGR image containing the court.
+        /// \param pointManager PointManager with mapping points of the court, user points are replaced only if the court is found.
+        /// \returns true if the court was found.
+        bool detect(const cv::Mat& image, PointManager& pointManager);
+
+        /// \returns mask of line pixels of the last image, in downscaled resolution.
+        const cv::Mat& getLineMask() const;
+
+        /// \returns maximal number of horizontal and vertical image lines used for matching.
+        int getMaxLines() const;
+
+        /// \returns minimal fraction of field line samples, which have to lie on image lines.
+        double getMinScore() const;
+
+        /// \returns width to which images are downscaled.
+        int getProcessingWidth() const;
+
+        /// \returns fraction of field line samples lying on image lines for the last detected court.
+        double getScore() const;
+
+        /// Set maximal number of horizontal and vertical image lines used for matching.
+        /// \param maxLines number of lines in each direction.
+        void setMaxLines(int maxLines);
+
+        /// Set minimal fraction of field line samples, which have to lie on image lines.
+        /// \param minScore fraction in range [0, 1].
+        void setMinScore(double minScore);
+
+        /// Set width to which images are downscaled before detection.
+        /// \param width width in pixels.
+        void setProcessingWidth(int width);
+
+    private:
+
+        /// \struct Line is used to store line found in image.
+        struct Line {
+
+            cv::Vec3f coefficients;
+
+            float length;
+
+        };
+
+        /// Extract pixels of court lines from downscaled image.
+        void computeLineMask();
+
+        /// Find lines in line mask and split them into horizontal and vertical lines.
+        void findLines();
+
+        /// Match image lines with lines of field.
+        /// \param mappingPoints mapping points of the court.
+        /// \param homography homography from mapping plane into downscaled image of the best match.
+        /// \returns false if no match passed the verification.
+        bool matchLines(const std::vector<cv::Point2f>& mappingPoints, cv::Matx33d& homography);
+
+        /// Fraction of samples, which lie on line pixels, samples outside of image are ignored.
+        /// \param homography homography from mapping plane into downscaled image.
+        /// \param score weighted number of samples on line pixels.
+        /// \returns fraction of samples on line pixels.
+        double verify(const cv::Matx33d& homography, double& score) const;
+
+        cv::Mat m_gray;
+
+        cv::Mat m_lineMask;
+
+        cv::Mat m_verificationMask;
+
+        std::vector<Line> m_horizontalLines;
+
+        std::vector<Line> m_verticalLines;
+
+        std::vector<cv::Point2f> m_samples;
+
+        double m_imageScale = 1.0;
+
+        double m_score = 0.0;
+
+        double m_minScore = 0.6;
+
+        int m_maxLines = 5;
+
+        int m_processingWidth = 960;
+
+};
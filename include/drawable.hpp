@@ -3,7 +3,9 @@
 
 #include <opencv2/core/core.hpp>
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 class Context;
 
@@ -17,6 +19,18 @@ class Context;
 /// thickness, object transparency and homography matrix.
 /// Every attribute has get and set method.
 ///
+/// Geometry of each drawable is cached. Every set method
+/// increases version of the drawable, and the geometry is
+/// recomputed in method prepare only if the version of the
+/// drawable, version of its homography or size of context
+/// changed since the geometry was last computed. Once the
+/// geometry is prepared, method getBounds returns region of
+/// context, which is modified when the object is drawn.
+///
+/// Renderer prepares geometry of different drawables
+/// concurrently, so method updateGeometry may modify only
+/// the drawable itself and may only read shared homography.
+///
 
 class Homography;
 
@@ -38,12 +52,29 @@ class Drawable {
         /// \return transparency value.
         virtual float getAlpha() const;
 
+        /// Returns region of context modified by the object. Method prepare has to be called first.
+        /// \returns bounding box of object in context.
+        virtual cv::Rect getBounds() const;
+
         /// \returns object color.
         virtual cv::Scalar getColor() const;
 
+        /// \returns homography used to draw object.
+        virtual const std::shared_ptr<Homography>& getHomography() const;
+
         /// \returns thickness value.
         virtual int getThickness() const;
 
+        /// \returns name of drawable type, which is used by profiler.
+        virtual const char* getTypeName() const;
+
+        /// \returns version of the drawable, which is increased every time the drawable is changed.
+        virtual std::uint64_t getVersion() const;
+
+        /// Recompute object geometry if it is outdated.
+        /// \param size of context.
+        virtual void prepare(const cv::Size& size);
+
         /// Set object transparency.
         /// \param alpha transparency value.
         virtual void setAlpha(float alpha);
@@ -58,6 +89,19 @@ class Drawable {
 
     protected:
 
+        /// Method for calculating object geometry, called by method prepare when geometry is outdated.
+        /// \param size of context.
+        virtual void updateGeometry(const cv::Size& size);
+
+        /// Mark object geometry as outdated.
+        void invalidate();
+
+        /// Pad bounding box of object points by line thickness and antialiasing.
+        /// \param points object points in context.
+        /// \param thickness line thickness.
+        /// \returns bounding box of drawn object.
+        static cv::Rect computeBounds(const std::vector<cv::Point>& points, int thickness);
+
         std::shared_ptr<Homography> m_homography;
 
         cv::Scalar m_color = { 0, 0, 0 };
@@ -66,4 +110,16 @@ class Drawable {
 
         float m_alpha = 1.0f;
 
+        std::uint64_t m_version;
+
+    private:
+
+        std::uint64_t m_geometryVersion = 0;
+
+        std::uint64_t m_geometryHomographyVersion = 0;
+
+        cv::Size m_geometrySize;
+
+        static std::uint64_t nextVersion();
+
 };
@@ -0,0 +1,149 @@
+
+#pragma once
+
+#include "drawable.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/// \struct DrawableHandle identifies drawable stored in DrawableStore.
+///
+/// Handle consists of index of slot and generation of the slot. Generation
+/// is changed when drawable is removed, so handles of removed drawables are
+/// detected as stale, even if their slot is reused. Default constructed
+/// handle does not identify any drawable.
+
+struct DrawableHandle {
+
+    std::uint32_t index = 0;
+
+    std::uint32_t generation = 0;
+
+    /// \returns true if handle does not identify any drawable.
+    bool isNull() const { return generation == 0; }
+
+    bool operator==(const DrawableHandle& other) const { return index == other.index && generation == other.generation; }
+
+    bool operator!=(const DrawableHandle& other) const { return !(*this == other); }
+
+};
+
+/// \class DrawableStore
+/// \brief Class to own drawables and keep them in draw order.
+///
+/// Class DrawableStore is a generational slot map of drawables.
+/// Drawables are inserted, removed and looked up by handles in
+/// constant time. Removed slots are reused by following insertions
+/// and operations with stale handles are ignored.
+///
+/// Drawables are kept in a contiguous array sorted by their draw
+/// order, which is the order of insertion unless it is changed by
+/// setOrder. Removal only releases the drawable and leaves an empty
+/// entry in the array, the array is compacted and sorted again by
+/// method compact, so many removals cost a single pass. Method
+/// compact has to be called before drawables are iterated.
+///
+
+class DrawableStore final {
+
+    public:
+
+        /// Insert drawable at the end of draw order.
+        /// \param drawable pointer to drawable instance.
+        /// \returns handle of inserted drawable, null handle if drawable is null.
+        DrawableHandle insert(std::unique_ptr<Drawable> drawable);
+
+        /// Remove drawable from store.
+        /// \param handle handle of drawable.
+        /// \returns removed drawable, null if the handle is stale.
+        std::unique_ptr<Drawable> remove(DrawableHandle handle);
+
+        /// Remove all drawables from store. All handles become stale.
+        void clear();
+
+        /// \param handle handle of drawable.
+        /// \returns pointer to drawable, null if the handle is stale.
+        Drawable* get(DrawableHandle handle) const;
+
+        /// \param drawable pointer to drawable.
+        /// \returns handle of drawable, null handle if drawable is not in store.
+        DrawableHandle find(const Drawable* drawable) const;
+
+        /// \param handle handle of drawable.
+        /// \returns true if drawable of the handle was not removed.
+        bool contains(DrawableHandle handle) const;
+
+        /// \param handle handle of drawable.
+        /// \returns draw order of drawable, drawables with smaller order are drawn first.
+        std::int64_t getOrder(DrawableHandle handle) const;
+
+        /// Set draw order of drawable. Drawables with the same order keep their relative order.
+        /// \param handle handle of drawable.
+        /// \param order drawables with smaller order are drawn first.
+        /// \returns false if the handle is stale.
+        bool setOrder(DrawableHandle handle, std::int64_t order);
+
+        /// Remove empty entries of removed drawables and sort drawables by draw order.
+        void compact();
+
+        /// \returns drawables in draw order, store is compacted first.
+        const std::vector<std::unique_ptr<Drawable>>& getDrawables();
+
+        /// \param position position in draw order of compacted store.
+        /// \returns handle of drawable at the position.
+        DrawableHandle getHandle(std::size_t position) const;
+
+        /// \returns number of slots, indices of all handles are smaller.
+        std::size_t getSlotCount() const;
+
+        /// \returns number of entries in draw order, including removed drawables until compact is called.
+        std::size_t size() const;
+
+        /// \returns true if there are no entries in draw order.
+        bool empty() const;
+
+        /// \param position position in draw order.
+        /// \returns drawable at the position.
+        const std::unique_ptr<Drawable>& operator[](std::size_t position) const;
+
+        /// \returns iterator to the first drawable in draw order.
+        std::vector<std::unique_ptr<Drawable>>::const_iterator begin() const;
+
+        /// \returns iterator past the last drawable in draw order.
+        std::vector<std::unique_ptr<Drawable>>::const_iterator end() const;
+
+    private:
+
+        /// \struct Slot is used to store generation, position in draw order and draw order of drawable.
+        struct Slot {
+
+            std::uint32_t generation = 1;
+
+            std::uint32_t position = 0;
+
+            std::int64_t order = 0;
+
+        };
+
+        /// \returns pointer to slot of the handle, null if the handle is stale.
+        const Slot* findSlot(DrawableHandle handle) const;
+
+        std::vector<Slot> m_slots;
+
+        std::vector<std::uint32_t> m_freeSlots;
+
+        std::vector<std::unique_ptr<Drawable>> m_drawables;
+
+        std::vector<DrawableHandle> m_handles;
+
+        std::unordered_map<const Drawable*, DrawableHandle> m_lookup;
+
+        std::int64_t m_nextOrder = 0;
+
+        std::size_t m_removedCount = 0;
+
+        bool m_sorted = true;
+
+};
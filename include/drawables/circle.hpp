@@ -20,6 +20,12 @@
 /// using constructor, method draw needs to be called,
 /// in order to render the object.
 ///
+/// By default the circle contour is computed analytically,
+/// the circle is sampled in the mapping plane and the samples
+/// are transformed back into the image, so the cost of the
+/// object depends only on its perimeter. Mode Raster renders
+/// the circle into a frame-sized image and extracts its contour.
+///
 /// After the object is created, it can be rendered into image
 /// by calling method addDrawble from the class Renderer.
 ///
@@ -27,6 +33,12 @@
 class Circle : public Drawable {
 
     public:
+        /// Mode is used to specify how the circle contour is computed.
+        enum class Mode {
+
+            Analytic, Raster
+
+        };
 
         /// Circle constructor.
         /// \param homography instance of class Homography with homography matrix inserted.
@@ -36,12 +48,25 @@ class Circle : public Drawable {
         /// \param context instance of Context class.
         virtual void draw(Context& context) override;
 
+        /// \returns bounding box of object in context.
+        virtual cv::Rect getBounds() const override;
+
+        /// \returns name of drawable type.
+        virtual const char* getTypeName() const override;
+
+        /// \returns mode used to compute circle contour.
+        virtual Mode getMode() const;
+
         /// \returns point used to draw object.
         virtual const cv::Point2f& getPoint() const;
 
         /// \returns radius of inserted circle.
         virtual int getRadius() const;
 
+        /// Method for setting the way circle contour is computed.
+        /// \param mode contour computation mode.
+        virtual void setMode(Mode mode);
+
         /// Method for setting circle point.
         /// \param point center point of circle.
         virtual void setPoint(cv::Point2f point);
@@ -59,14 +84,27 @@ class Circle : public Drawable {
 
     protected:
 
+        /// Method for calculating object geometry.
+        /// \param size of context.
+        virtual void updateGeometry(const cv::Size& size) override;
+
         /// Method for calculating new object points.
         /// \param size of context.
         virtual void updatePoints(const cv::Size& size);
 
+        /// Method for sampling the circle in the mapping plane and transforming the samples into image.
+        virtual void updatePointsAnalytic();
+
+        /// Method for rendering the circle into temporary image and extracting its contour.
+        /// \param size of context.
+        virtual void updatePointsRaster(const cv::Size& size);
+
         std::vector<std::vector<cv::Point>> m_points;
 
         cv::Point2f m_point;
 
         int m_radius = 1;
 
+        Mode m_mode = Mode::Analytic;
+
 };
@@ -28,6 +28,10 @@
 /// created by using constructor, method draw needs to be 
 /// called, in order to render the object.
 ///
+/// Rotated and resized image is cached between draws. When
+/// drawn, the image is warped only into its bounding box in
+/// context and composited in place.
+///
 /// After the object is created, it can be rendered into image
 /// by calling method addDrawble from the class Renderer.
 ///
@@ -50,6 +54,12 @@ class Image : public Drawable {
         /// \param context instance of Context class.
         virtual void draw(Context& context) override;
 
+        /// \returns bounding box of object in context.
+        virtual cv::Rect getBounds() const override;
+
+        /// \returns name of drawable type.
+        virtual const char* getTypeName() const override;
+
         /// \returns first point used to draw object.
         virtual const cv::Point2f& getFrom() const;
 
@@ -66,7 +76,8 @@ class Image : public Drawable {
         /// \param from first point.
         virtual void setFrom(cv::Point2f from);
 
-        /// Method for setting input image.
+        /// Method for setting input image. Image data is shared with the caller, if the
+        /// image is modified afterwards, this method has to be called again.
         /// \param image matrix containing input image.
         virtual void setImage(cv::Mat image);
 
@@ -89,10 +100,27 @@ class Image : public Drawable {
 
     protected:
 
+        /// Method for calculating object geometry and preparing the rotated and resized image.
+        /// \param size of context.
+        virtual void updateGeometry(const cv::Size& size) override;
+
+        /// Compute matrix, which transforms prepared image into region of context.
+        /// \param origin top left corner of the region in context.
+        /// \returns perspective transformation matrix.
+        cv::Matx33d computeWarpMatrix(const cv::Point& origin) const;
+
         std::vector<std::vector<cv::Point>> m_points;
 
         cv::Mat m_image;
 
+        cv::Mat m_preparedImage;
+
+        cv::Mat m_preparedAlpha;
+
+        cv::Point m_position;
+
+        bool m_hasAlpha = false;
+
         cv::Point2f m_from;
 
         cv::Point2f m_to;
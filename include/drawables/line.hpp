@@ -46,6 +46,12 @@ class Line : public Drawable {
         /// \param context instance of Context class.
         virtual void draw(Context& context) override;
 
+        /// \returns bounding box of object in context.
+        virtual cv::Rect getBounds() const override;
+
+        /// \returns name of drawable type.
+        virtual const char* getTypeName() const override;
+
         /// \returns line offset.
         virtual float getOffset() const;
 
@@ -78,6 +84,10 @@ class Line : public Drawable {
 
     protected:
 
+        /// Method for calculating object geometry.
+        /// \param size of context.
+        virtual void updateGeometry(const cv::Size& size) override;
+
         /// Method for calculating new object points.
         /// \param size of mapping window.
         virtual void updatePoints(const cv::Size& size);
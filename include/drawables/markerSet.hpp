@@ -0,0 +1,162 @@
+
+#pragma once
+
+#include "drawable.hpp"
+
+#include <memory>
+#include <vector>
+
+/// \class MarkerSet
+/// \brief Class MarkerSet can be used for inserting many circular markers into image.
+///
+/// Class MarkerSet draws large number of markers, such as tracked
+/// players or balls, as a single object. Markers are circles with
+/// center in image and radius in mapping plane, the same as with the
+/// class Circle. Positions, radii, colors and transparencies of the
+/// markers are stored in contiguous arrays, so positions from tracker
+/// can be updated by a single copy using setPositions. New markers get
+/// radius, color and transparency of the marker set.
+///
+/// Contours of all markers are computed together, centers are projected
+/// into mapping plane in one pass, the circles are sampled there and all
+/// samples are transformed back into the image in one pass. Markers are
+/// grouped by color and transparency and each group is rasterized by a
+/// single call, markers outside of the context clip are skipped. Negative
+/// thickness draws filled markers.
+///
+/// After the object is created, it can be rendered into image
+/// by calling method addDrawble from the class Renderer.
+///
+
+class MarkerSet : public Drawable {
+
+    public:
+
+        /// MarkerSet constructor.
+        /// \param homography instance of class Homography with homography matrix inserted.
+        explicit MarkerSet(std::shared_ptr<Homography> homography);
+
+        /// Method for drawing object.
+        /// \param context instance of Context class.
+        virtual void draw(Context& context) override;
+
+        /// \returns bounding box of all markers in context.
+        virtual cv::Rect getBounds() const override;
+
+        /// \returns name of drawable type.
+        virtual const char* getTypeName() const override;
+
+        /// \returns transparencies of markers.
+        virtual const std::vector<float>& getAlphas() const;
+
+        /// \returns BGR colors of markers.
+        virtual const std::vector<cv::Vec3b>& getColors() const;
+
+        /// \returns number of markers.
+        virtual std::size_t getCount() const;
+
+        /// \returns center points of markers in image.
+        virtual const std::vector<cv::Point2f>& getPositions() const;
+
+        /// \returns radii of markers in mapping plane.
+        virtual const std::vector<float>& getRadii() const;
+
+        /// \returns radius of new markers.
+        virtual float getRadius() const;
+
+        /// Method for setting transparency of all markers.
+        /// \param alpha transparency in range [0, 1].
+        virtual void setAlpha(float alpha) override;
+
+        /// Method for setting transparencies of markers.
+        /// \param alphas transparencies in range [0, 1].
+        /// \param count number of values, at most number of markers.
+        virtual void setAlphas(const float* alphas, std::size_t count);
+
+        /// Method for setting color of all markers.
+        /// \param color BGR color.
+        virtual void setColor(cv::Scalar color) override;
+
+        /// Method for setting colors of markers.
+        /// \param colors BGR colors.
+        /// \param count number of values, at most number of markers.
+        virtual void setColors(const cv::Vec3b* colors, std::size_t count);
+
+        /// Method for setting number of markers, new markers are placed at origin.
+        /// \param count number of markers.
+        virtual void setCount(std::size_t count);
+
+        /// Method for setting center points of markers, number of markers is set to number of points.
+        /// \param positions center points in image.
+        /// \param count number of points.
+        virtual void setPositions(const cv::Point2f* positions, std::size_t count);
+
+        /// Method for setting center points of markers, number of markers is set to number of points.
+        /// \param positions center points in image.
+        virtual void setPositions(const std::vector<cv::Point2f>& positions);
+
+        /// Method for setting radii of markers.
+        /// \param radii radii in mapping plane.
+        /// \param count number of values, at most number of markers.
+        virtual void setRadii(const float* radii, std::size_t count);
+
+        /// Method for setting radius of all markers.
+        /// \param radius radius in mapping plane.
+        virtual void setRadius(float radius);
+
+        /// Create new instance of MarkerSet class.
+        /// \param homography instance of class Homography with homography matrix inserted.
+        /// \param positions center points of markers in image.
+        /// \param radius radius of markers in mapping plane.
+        /// \returns pointer to the newly created instance.
+        static std::unique_ptr<MarkerSet> create(std::shared_ptr<Homography> homography, const std::vector<cv::Point2f>& positions, float radius);
+
+    protected:
+
+        /// \struct Group is used to store range of markers with the same color and transparency.
+        struct Group {
+
+            cv::Scalar color;
+
+            float alpha;
+
+            std::size_t begin;
+
+            std::size_t end;
+
+        };
+
+        /// Method for calculating object geometry.
+        /// \param size of context.
+        virtual void updateGeometry(const cv::Size& size) override;
+
+        /// Method for sorting markers into groups of the same color and transparency.
+        virtual void updateGroups();
+
+        std::vector<cv::Point2f> m_positions;
+
+        std::vector<float> m_radii;
+
+        std::vector<cv::Vec3b> m_colors;
+
+        std::vector<float> m_alphas;
+
+        std::vector<cv::Point2f> m_centers;
+
+        std::vector<cv::Point2f> m_samples;
+
+        std::vector<cv::Point> m_points;
+
+        std::vector<std::size_t> m_offsets;
+
+        std::vector<cv::Rect> m_markerBounds;
+
+        std::vector<std::size_t> m_order;
+
+        std::vector<Group> m_groups;
+
+        cv::Rect m_bounds;
+
+        float m_radius = 1.0f;
+
+};
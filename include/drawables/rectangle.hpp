@@ -20,6 +20,11 @@
 /// created by using constructor, method draw needs to be
 /// called, in order to render the object.
 ///
+/// Corners of the object are computed in the mapping plane and
+/// transformed into the image at once. Each edge can optionally
+/// be subdivided into several segments by calling method
+/// setSubdivisions.
+///
 /// After the object is created, it can be rendered into image
 /// by calling method addDrawble from the class Renderer.
 ///
@@ -44,12 +49,21 @@ class Rectangle : public Drawable {
         /// \param context instance of Context class.
         virtual void draw(Context& context) override;
 
+        /// \returns bounding box of object in context.
+        virtual cv::Rect getBounds() const override;
+
+        /// \returns name of drawable type.
+        virtual const char* getTypeName() const override;
+
         /// \returns first point used to draw object.
         virtual const cv::Point2f& getFrom() const;
 
         /// \returns second point used to draw object.
         virtual const cv::Point2f& getTo() const;
 
+        /// \returns number of points inserted into each edge.
+        virtual int getSubdivisions() const;
+
         /// \returns object type.
         virtual Type getType() const;
 
@@ -57,6 +71,10 @@ class Rectangle : public Drawable {
         /// \param from first point.
         virtual void setFrom(cv::Point2f from);
 
+        /// Method for setting number of points inserted into each edge.
+        /// \param subdivisions number of points inserted between two corners.
+        virtual void setSubdivisions(int subdivisions);
+
         /// Method for setting second point.
         /// \param to second point.
         virtual void setTo(cv::Point2f to);
@@ -75,6 +93,10 @@ class Rectangle : public Drawable {
 
     protected:
 
+        /// Method for calculating object geometry.
+        /// \param size of context.
+        virtual void updateGeometry(const cv::Size& size) override;
+
         /// Method for calculating new object points.
         /// \param size of context.
         virtual void updatePoints(const cv::Size& size);
@@ -87,4 +109,6 @@ class Rectangle : public Drawable {
 
         cv::Point2f m_to;
 
+        int m_subdivisions = 0;
+
 };
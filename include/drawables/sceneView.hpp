@@ -0,0 +1,79 @@
+
+#pragma once
+
+#include "drawable.hpp"
+#include "worldScene.hpp"
+
+#include <memory>
+#include <vector>
+
+/// \class SceneView
+/// \brief Class SceneView can be used for inserting shapes of WorldScene into image.
+///
+/// Class SceneView draws all shapes of a scene, which is defined in
+/// mapping plane, through homography of one camera. Many views can
+/// share one scene, each with its own homography, so shapes are not
+/// duplicated for every camera. Points of the scene are transformed
+/// into image in one pass and shapes outside of the context clip are
+/// skipped. Shapes with points, which can not be transformed into
+/// image, are not drawn.
+///
+/// Color and thickness are attributes of shapes, transparency of the
+/// view multiplies transparency of every shape. Geometry is computed
+/// again when the scene, the homography or size of context changes.
+///
+/// After the object is created, it can be rendered into image
+/// by calling method addDrawble from the class Renderer.
+///
+
+class SceneView : public Drawable {
+
+    public:
+
+        /// SceneView constructor.
+        /// \param homography instance of class Homography with homography matrix inserted.
+        /// \param scene scene with shapes in mapping plane.
+        SceneView(std::shared_ptr<Homography> homography, std::shared_ptr<WorldScene> scene);
+
+        /// Method for drawing object.
+        /// \param context instance of Context class.
+        virtual void draw(Context& context) override;
+
+        /// \returns bounding box of all shapes in context.
+        virtual cv::Rect getBounds() const override;
+
+        /// \returns name of drawable type.
+        virtual const char* getTypeName() const override;
+
+        /// \returns scene drawn by the view.
+        virtual const std::shared_ptr<WorldScene>& getScene() const;
+
+        /// Recompute object geometry if it or the scene is outdated.
+        /// \param size of context.
+        virtual void prepare(const cv::Size& size) override;
+
+        /// Create new instance of SceneView class.
+        /// \param homography instance of class Homography with homography matrix inserted.
+        /// \param scene scene with shapes in mapping plane.
+        /// \returns pointer to the newly created instance.
+        static std::unique_ptr<SceneView> create(std::shared_ptr<Homography> homography, std::shared_ptr<WorldScene> scene);
+
+    protected:
+
+        /// Method for calculating object geometry.
+        /// \param size of context.
+        virtual void updateGeometry(const cv::Size& size) override;
+
+        std::shared_ptr<WorldScene> m_scene;
+
+        std::uint64_t m_sceneVersion = 0;
+
+        std::vector<cv::Point2f> m_samples;
+
+        std::vector<cv::Point> m_points;
+
+        std::vector<cv::Rect> m_shapeBounds;
+
+        cv::Rect m_bounds;
+
+};
@@ -0,0 +1,153 @@
+
+#pragma once
+
+#include "boundedQueue.hpp"
+#include "renderer.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/// \class FramePipeline
+/// \brief Class to render drawables over a stream of frames.
+///
+/// Class FramePipeline reads frames from a source, renders
+/// drawables of a Renderer over each frame and passes the
+/// result to a sink. Reading, rendering and writing run on
+/// three separate threads connected by bounded queues, so
+/// reading of the next frame and writing of the previous
+/// frame overlap with rendering. Size of the queues limits
+/// how many frames the pipeline can hold, which bounds the
+/// latency between reading and writing of a frame.
+///
+/// Drawables are blended directly into the BGR frames by method
+/// Renderer::renderOnto, so frames are never converted to BGRA.
+/// Frame buffers are recycled, when the sink consumes a frame,
+/// its buffer is returned to the source and reused for another
+/// frame. Sink therefore must not keep a shallow reference to the
+/// frame after it returns, frames, which are needed later, have to
+/// be cloned. Renderer reuses its context for frames of the same
+/// size, so frames of a stream with constant size are processed
+/// without new allocations.
+///
+/// Renderer is used only from the render thread while the
+/// pipeline is running. Drawables can be changed in update
+/// callback, which is called on the render thread before
+/// every frame is rendered.
+///
+/// Source and sink for cv::VideoCapture and cv::VideoWriter
+/// can be created by methods createSource and createSink.
+///
+
+class FramePipeline final {
+
+    public:
+
+        /// Source is called to read the next frame, returns false at the end of stream.
+        using Source = std::function<bool(cv::Mat& frame)>;
+
+        /// Sink is called with each rendered frame in BGR format. Buffer of the frame is reused
+        /// after the sink returns, so the sink has to copy the frame if it keeps it.
+        using Sink = std::function<void(const cv::Mat& frame)>;
+
+        /// Update callback is called before the frame with given index is rendered.
+        using UpdateCallback = std::function<void(Renderer& renderer, std::uint64_t frameIndex)>;
+
+        /// FramePipeline constructor.
+        /// \param renderer renderer used to render frames.
+        /// \param queueSize maximal number of frames waiting between two threads.
+        explicit FramePipeline(Renderer& renderer, std::size_t queueSize = 2);
+
+        /// FramePipeline destructor, stops running pipeline.
+        ~FramePipeline();
+
+        FramePipeline(const FramePipeline&) = delete;
+
+        FramePipeline& operator=(const FramePipeline&) = delete;
+
+        /// Start reading, rendering and writing of frames.
+        /// \param source function returning frames.
+        /// \param sink function receiving rendered frames.
+        void start(Source source, Sink sink);
+
+        /// Stop the pipeline, frames waiting in queues are dropped and are not passed to sink.
+        void stop();
+
+        /// Wait until all frames of source are written. Exception thrown
+        /// by source, sink, update callback or renderer is rethrown.
+        void wait();
+
+        /// \returns number of frames passed to sink.
+        std::uint64_t getFrameCount() const;
+
+        /// \returns true if the pipeline is running.
+        bool isRunning() const;
+
+        /// Set function, that is called before each frame is rendered.
+        /// \param callback update callback, can be empty.
+        void setUpdateCallback(UpdateCallback callback);
+
+        /// Create source reading frames from video capture.
+        /// \param capture opened video capture, which has to exist while the pipeline is running.
+        /// \returns source function.
+        static Source createSource(cv::VideoCapture& capture);
+
+        /// Create sink writing frames to video writer.
+        /// \param writer opened video writer, which has to exist while the pipeline is running.
+        /// \returns sink function.
+        static Sink createSink(cv::VideoWriter& writer);
+
+    private:
+
+        /// Read frames from source into decoded frames queue.
+        void decode(Source source);
+
+        /// Render decoded frames into rendered frames queue.
+        void render();
+
+        /// Pass rendered frames to sink.
+        void encode(Sink sink);
+
+        /// Store exception of a stage and stop the pipeline.
+        void fail(std::exception_ptr exception);
+
+        /// Close all queues, which stops all threads.
+        void closeQueues();
+
+        /// Wait for all threads.
+        void join();
+
+        Renderer& m_renderer;
+
+        std::size_t m_queueSize;
+
+        UpdateCallback m_updateCallback;
+
+        BoundedQueue<cv::Mat> m_freeFrames;
+
+        BoundedQueue<cv::Mat> m_decodedFrames;
+
+        BoundedQueue<cv::Mat> m_renderedFrames;
+
+        std::thread m_decodeThread;
+
+        std::thread m_renderThread;
+
+        std::thread m_encodeThread;
+
+        std::atomic<std::uint64_t> m_frameCount { 0 };
+
+        // Set by stop and by failed stages, queued frames are then dropped instead of being processed.
+        std::atomic<bool> m_stopped { false };
+
+        std::exception_ptr m_exception;
+
+        std::mutex m_exceptionMutex;
+
+};
@@ -1,6 +1,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -23,6 +26,39 @@
 /// matrix. Inverse homography matrix can be rerieved by
 /// calling method getInverseHomographyMatrix.
 ///
+/// Every time homography matrix is set, version of the
+/// homography is increased. Drawables use the version to
+/// detect, that their cached geometry is outdated.
+///
+/// Images can be warped by calling method warpImage. Remap
+/// tables for each output size are computed once and cached
+/// until homography matrix changes, so warping an image with
+/// unchanged homography only remaps its pixels.
+/// Homography can be copied, the copy starts with an empty
+/// cache of remap tables.
+///
+/// Points can be transformed in batches by calling methods
+/// project (from image into mapping plane) and unproject (from
+/// mapping plane into image). Both methods use matrices cached
+/// when homography matrix is set and process several points
+/// at once using SIMD instructions. Points are transformed in
+/// double precision, the same as by cv::perspectiveTransform,
+/// and points with w close to zero (on the horizon of the other
+/// plane) are transformed into the origin.
+///
+/// Homography matrix is estimated by least squares from all
+/// user points by default. Method setMethod selects robust
+/// estimation by RANSAC or USAC, which ignores user points with
+/// reprojection error larger than the threshold. USAC requires
+/// OpenCV 4.5 or newer, older versions fall back to RANSAC.
+/// Reprojection error of the estimate and mask of inliers can be
+/// retrieved after each estimation.
+///
+/// When a user point is added or moved, method refineHomographyMatrix
+/// updates the previous estimate by a few Levenberg-Marquardt
+/// iterations instead of estimating the matrix again, which is
+/// much faster for interactive editing of user points.
+///
 
 class PointManager;
 
@@ -30,6 +66,13 @@ class Homography final {
 
     public:
 
+        /// Method specifies how homography matrix is estimated from user points.
+        enum class Method {
+
+            LeastSquares, RANSAC, USAC
+
+        };
+
         /// Default constructor.
         Homography();
 
@@ -41,20 +84,171 @@ class Homography final {
         /// \param pointManager PointManager instance.
         void computeHomographyMatrix(const PointManager& pointManager);
 
+        /// Refine homography matrix from the previous estimate using Levenberg-Marquardt iterations.
+        /// Matrix is computed by method computeHomographyMatrix, if there is no previous estimate
+        /// or if refinement does not converge. Inlier mask is kept, if number of user points did
+        /// not change, otherwise all user points are used.
+        /// \param pointManager PointManager instance.
+        /// \param iterations maximal number of iterations.
+        void refineHomographyMatrix(const PointManager& pointManager, int iterations = 10);
+
         /// \returns homography matrix.
         cv::Mat getHomographyMatrix() const;
 
         /// \returns inverse homography matrix.
         cv::Mat getInverseHomographyMatrix() const;
 
+        /// \returns homography matrix in double precision.
+        const cv::Matx33d& getMatrix() const;
+
+        /// \returns inverse homography matrix in double precision.
+        const cv::Matx33d& getInverseMatrix() const;
+
+        /// \returns version of homography matrix, which changes every time the matrix is set or the homography is copied.
+        std::uint64_t getVersion() const;
+
+        /// \returns method used to estimate homography matrix.
+        Method getMethod() const;
+
+        /// \returns mask of user points, nonzero values mark inliers of the last estimation.
+        const std::vector<unsigned char>& getInlierMask() const;
+
+        /// \returns root mean square distance in mapping plane between transformed image
+        /// points and mapping points of inliers of the last estimation.
+        double getReprojectionError() const;
+
+        /// \returns maximal reprojection error of inliers in mapping plane used by RANSAC and USAC.
+        double getReprojectionThreshold() const;
+
+        /// Get remap tables, which can be used with cv::remap to warp image.
+        /// \param size size of warped image.
+        /// \param inverse if set to true, image is warped using inverse homography matrix.
+        /// \param map1 matrix into which fixed-point coordinates (CV_16SC2) will be inserted.
+        /// \param map2 matrix into which interpolation table indices (CV_16UC1) will be inserted.
+        void getWarpMaps(const cv::Size& size, bool inverse, cv::Mat& map1, cv::Mat& map2) const;
+
+        /// Transform points from image into mapping plane.
+        /// \param points pointer to the first point in image.
+        /// \param output pointer to the first transformed point, can be the same as points.
+        /// \param count number of transformed points.
+        void project(const cv::Point2f* points, cv::Point2f* output, std::size_t count) const;
+
+        /// Transform points from image into mapping plane.
+        /// \param points vector containing points in image.
+        /// \param output vector into which transformed points will be inserted, can be the same as points.
+        void project(const std::vector<cv::Point2f>& points, std::vector<cv::Point2f>& output) const;
+
+        /// Transform points from mapping plane into image.
+        /// \param points pointer to the first point in mapping plane.
+        /// \param output pointer to the first transformed point, can be the same as points.
+        /// \param count number of transformed points.
+        void unproject(const cv::Point2f* points, cv::Point2f* output, std::size_t count) const;
+
+        /// Transform points from mapping plane into image.
+        /// \param points vector containing points in mapping plane.
+        /// \param output vector into which transformed points will be inserted, can be the same as points.
+        void unproject(const std::vector<cv::Point2f>& points, std::vector<cv::Point2f>& output) const;
+
         /// Set existing homography matrix.
         /// \param matrix homography matrix.
         void setHomographyMatrix(cv::Mat matrix);
 
+        /// Set method used to estimate homography matrix.
+        /// \param method estimation method.
+        void setMethod(Method method);
+
+        /// Set maximal reprojection error of inliers used by RANSAC and USAC.
+        /// \param threshold distance in mapping plane.
+        void setReprojectionThreshold(double threshold);
+
+        /// Warp image using cached remap tables. Result is the same as warping image with cv::warpPerspective.
+        /// \param image matrix containing image that will be warped.
+        /// \param size size of warped image.
+        /// \param inverse if set to true, image is warped using inverse homography matrix.
+        /// \returns matrix containing warped image.
+        cv::Mat warpImage(cv::Mat image, const cv::Size& size, bool inverse = false) const;
+
     private:
 
+        /// \struct WarpMaps is used to store remap tables for single output size.
+        struct WarpMaps {
+
+            cv::Size size;
+
+            bool inverse;
+
+            cv::Mat map1;
+
+            cv::Mat map2;
+
+        };
+
+        /// \struct WarpMapsCache is used to store remap tables of the current matrix.
+        /// Copy of the cache is empty, so homography stays copyable and copies
+        /// compute their own remap tables.
+        struct WarpMapsCache {
+
+            WarpMapsCache() = default;
+
+            WarpMapsCache(const WarpMapsCache&) {}
+
+            WarpMapsCache& operator=(const WarpMapsCache&);
+
+            std::vector<WarpMaps> maps;
+
+            std::mutex mutex;
+
+        };
+
+        /// \struct Version contains version of the matrix, which is unique across all homographies.
+        /// Copy of the version is a new version, so drawables sharing a homography notice
+        /// when another homography is assigned into it.
+        struct Version {
+
+            Version();
+
+            Version(const Version&);
+
+            Version& operator=(const Version&);
+
+            std::uint64_t value;
+
+        };
+
         cv::Mat m_homographyMatrix;
 
         cv::Mat m_inverseHomographyMatrix;
 
+        cv::Matx33d m_matrix;
+
+        cv::Matx33d m_inverseMatrix;
+
+        /// Store matrix and its inverse without resetting estimation results.
+        /// \param matrix homography matrix in double precision.
+        /// \param type type of matrices returned by getHomographyMatrix and getInverseHomographyMatrix.
+        void updateMatrices(const cv::Matx33d& matrix, int type);
+
+        /// Store estimation results and compute reprojection error of inliers.
+        /// \param imagePoints image points of user points.
+        /// \param mappingPoints mapping points of user points.
+        void updateReprojectionError(const std::vector<cv::Point2f>& imagePoints, const std::vector<cv::Point2f>& mappingPoints);
+
+        Version m_version;
+
+        Method m_method = Method::LeastSquares;
+
+        double m_reprojectionThreshold = 3.0;
+
+        double m_reprojectionError = 0.0;
+
+        std::vector<unsigned char> m_inlierMask;
+
+        std::vector<cv::Point2f> m_projectedPoints;
+
+        bool m_estimated = false;
+
+        mutable WarpMapsCache m_warpMapsCache;
+
+        static std::uint64_t nextVersion();
+
 };
@@ -0,0 +1,155 @@
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <memory>
+#include <vector>
+
+/// \class HomographyTracker
+/// \brief Class to keep homography up to date while the camera moves.
+///
+/// Class HomographyTracker updates homography matrix of a moving
+/// (panning, tilting or zooming) camera from frame to frame, so the
+/// user points do not need to be placed again. Tracking is started
+/// by method initialize with the frame in which the user points were
+/// placed. Corner features are then detected in neighbourhood of the
+/// user points and followed into each following frame by sparse
+/// optical flow. Motion of the camera between two frames is estimated
+/// as homography from the tracked features by RANSAC and accumulated,
+/// user points are moved by the accumulated motion and homography
+/// matrix is estimated again from the moved user points.
+///
+/// Frames are converted to grayscale and downscaled before tracking,
+/// which keeps cost of tracking small compared to frame time even for
+/// high resolution video. Positions of user points are smoothed by
+/// exponential moving average to reduce jitter of the homography,
+/// larger smoothing reduces jitter, but the homography lags behind
+/// fast camera motion. Features, which are lost, are replaced by new
+/// features detected around the moved user points.
+///
+/// Small errors of estimated motion accumulate over time, so the
+/// tracking should be initialized again, when user points are placed
+/// again or improved. Method track returns false, when not enough
+/// features could be tracked, homography is not updated in that case.
+///
+
+class Homography;
+class PointManager;
+
+class HomographyTracker final {
+
+    public:
+
+        /// HomographyTracker constructor.
+        /// \param homography homography, which is updated by tracking.
+        explicit HomographyTracker(std::shared_ptr<Homography> homography);
+
+        /// Start tracking. Homography matrix is computed from user points.
+        /// \param frame frame in which user points were placed, BGR or grayscale.
+        /// \param pointManager PointManager instance containing at least 4 user points.
+        /// \returns true if enough features were found for tracking.
+        bool initialize(const cv::Mat& frame, const PointManager& pointManager);
+
+        /// Track camera motion into the next frame and update homography matrix.
+        /// \param frame the next frame, BGR or grayscale of the same size as the initial frame.
+        /// \returns true if homography matrix was updated, false if tracking was lost.
+        bool track(const cv::Mat& frame);
+
+        /// Stop tracking.
+        void reset();
+
+        /// \returns true if the tracker was initialized and tracking was not lost.
+        bool isTracking() const;
+
+        /// \returns number of features tracked in the last frame.
+        int getFeatureCount() const;
+
+        /// \returns smoothed positions of user points in the last tracked frame.
+        const std::vector<cv::Point2f>& getImagePoints() const;
+
+        /// \returns maximal number of tracked features.
+        int getMaxFeatures() const;
+
+        /// \returns factor by which frames are downscaled before tracking.
+        double getScale() const;
+
+        /// \returns radius around user points in which features are detected.
+        int getSearchRadius() const;
+
+        /// \returns smoothing factor of user point positions.
+        double getSmoothing() const;
+
+        /// Set maximal number of tracked features.
+        /// \param maxFeatures number of features.
+        void setMaxFeatures(int maxFeatures);
+
+        /// Set factor by which frames are downscaled before tracking, takes effect on initialize.
+        /// \param scale factor in range (0, 1].
+        void setScale(double scale);
+
+        /// Set radius around user points in which features are detected.
+        /// \param searchRadius radius in pixels of the original frame.
+        void setSearchRadius(int searchRadius);
+
+        /// Set smoothing factor of user point positions.
+        /// \param smoothing factor in range [0, 1), 0 disables smoothing.
+        void setSmoothing(double smoothing);
+
+    private:
+
+        /// Convert frame into downscaled grayscale image and build its optical flow pyramid.
+        /// \param frame BGR or grayscale frame.
+        /// \returns false if the frame can not be used.
+        bool preparePyramid(const cv::Mat& frame);
+
+        /// Detect new features around current positions of user points.
+        void detectFeatures();
+
+        std::shared_ptr<Homography> m_homography;
+
+        std::vector<cv::Point2f> m_referencePoints;
+
+        std::vector<cv::Point2f> m_mappingPoints;
+
+        std::vector<cv::Point2f> m_imagePoints;
+
+        cv::Matx33d m_motion;
+
+        cv::Size m_frameSize;
+
+        cv::Mat m_gray;
+
+        cv::Mat m_scaled;
+
+        cv::Mat m_mask;
+
+        std::vector<cv::Mat> m_pyramid;
+
+        std::vector<cv::Mat> m_previousPyramid;
+
+        std::vector<cv::Point2f> m_features;
+
+        std::vector<cv::Point2f> m_trackedFeatures;
+
+        std::vector<cv::Point2f> m_returnedFeatures;
+
+        std::vector<unsigned char> m_status;
+
+        std::vector<unsigned char> m_returnedStatus;
+
+        std::vector<float> m_errors;
+
+        int m_maxFeatures = 200;
+
+        double m_scale = 0.5;
+
+        double m_pyramidScale = 0.5;
+
+        int m_searchRadius = 60;
+
+        double m_smoothing = 0.3;
+
+        bool m_tracking = false;
+
+};
@@ -0,0 +1,128 @@
+
+#pragma once
+
+#include "homography.hpp"
+#include "renderer.hpp"
+#include "worldScene.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/// \class MultiViewRenderer
+/// \brief Class to render scenes in mapping plane into several camera views.
+///
+/// Class MultiViewRenderer renders the same scenes into frames of
+/// several cameras, for example cameras watching one court. Every
+/// view has its own homography, renderer and frame size, while scenes
+/// are shared, so shapes defined in mapping plane are not duplicated
+/// for every camera. Each scene is drawn into every view by a SceneView
+/// in the given layer of the view renderer. Layers added by addLayer
+/// are created in every view, so static scenes, such as court lines,
+/// can be cached by every view.
+///
+/// Method render prepares points of all scenes in mapping plane once
+/// and then renders the views in parallel, each view is a separate task
+/// of the worker pool. Transformation of the scenes into image and
+/// rasterization are done per view. Renderer of a view can be obtained
+/// by getRenderer to set its background image or to add drawables, which
+/// are drawn only in that view.
+///
+
+class MultiViewRenderer final {
+
+    public:
+
+        /// Add view of camera. Layers and scenes added before are added into the view.
+        /// \param homography homography of the camera.
+        /// \returns index of the view.
+        std::size_t addView(std::shared_ptr<Homography> homography);
+
+        /// Add layer into every view.
+        /// \param name name of the layer.
+        /// \param order layers are blended in ascending order.
+        /// \param isStatic if set to true, drawables of the layer are cached.
+        /// \returns false if layer with the name already exists.
+        bool addLayer(const std::string& name, int order, bool isStatic = false);
+
+        /// Add scene into every view.
+        /// \param scene scene with shapes in mapping plane.
+        /// \param layer name of layer added by addLayer, the scene is drawn into default layer otherwise.
+        void addScene(std::shared_ptr<WorldScene> scene, const std::string& layer = Renderer::defaultLayerName);
+
+        /// Render all views into their output images. Views without background image are skipped.
+        void render();
+
+        /// Render all views directly into frames. Background images are not used.
+        /// \param frames frame of every view, see Renderer::renderOnto.
+        /// \param format layout of the frames.
+        void renderOnto(const std::vector<cv::Mat>& frames, Renderer::FrameFormat format = Renderer::FrameFormat::BGR);
+
+        /// \param view index of the view.
+        /// \returns homography of the view.
+        const std::shared_ptr<Homography>& getHomography(std::size_t view) const;
+
+        /// \returns true if views are rendered in parallel.
+        bool getParallelViews() const;
+
+        /// \param view index of the view.
+        /// \returns renderer of the view.
+        Renderer& getRenderer(std::size_t view);
+
+        /// \returns scenes drawn into every view.
+        std::vector<std::shared_ptr<WorldScene>> getScenes() const;
+
+        /// \returns number of views.
+        std::size_t getViewCount() const;
+
+        /// Enable or disable parallel rendering of views.
+        /// \param enabled if set to true, views are rendered in parallel.
+        void setParallelViews(bool enabled);
+
+    private:
+
+        /// \struct View contains homography and renderer of one camera.
+        struct View {
+
+            std::shared_ptr<Homography> homography;
+
+            std::unique_ptr<Renderer> renderer;
+
+        };
+
+        /// \struct Layer contains attributes of layer added into every view.
+        struct Layer {
+
+            std::string name;
+
+            int order = 0;
+
+            bool isStatic = false;
+
+        };
+
+        /// \struct Scene contains scene and name of its layer.
+        struct Scene {
+
+            std::shared_ptr<WorldScene> scene;
+
+            std::string layer;
+
+        };
+
+        /// Prepare points of all scenes in mapping plane.
+        void prepareScenes();
+
+        /// Call function for every view, in parallel if enabled.
+        template<typename Function>
+        void forEachView(Function function);
+
+        std::vector<View> m_views;
+
+        std::vector<Layer> m_layers;
+
+        std::vector<Scene> m_scenes;
+
+        bool m_parallelViews = true;
+
+};
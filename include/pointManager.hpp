@@ -3,8 +3,9 @@
 
 #include <opencv2/opencv.hpp>
 
-#include <list>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -29,11 +30,21 @@
 /// and removed by calling method removeUserPoint. Position of
 /// image point can be improved by calling method improvePoints.
 ///
+/// Image points and mapping points of user points are stored in two
+/// contiguous arrays in order of insertion, which are passed directly
+/// to homography estimation without copying. Each user point has an
+/// identifier returned by addUserPoint, which does not change when
+/// other user points are added or removed, and which is used to move
+/// or remove the user point.
+///
 
 class PointManager {
 
     public:
 
+        /// UserPointId identifies user point, identifiers are not reused.
+        using UserPointId = std::uint64_t;
+
         /// \struct UserPoint is used to store pair of image and mapping points.
         struct UserPoint {
 
@@ -41,6 +52,8 @@ class PointManager {
 
             cv::Point2f mappingPoint;
 
+            UserPointId id = 0;
+
         };
 
         /// PointManager constructor
@@ -55,12 +68,13 @@ class PointManager {
         /// This method is used to add pairs of image and mapping points to PointManager instance.
         /// \param imagePoint coordinates of points in real image.
         /// \param mappingPoints coordinates of coresponding image point in 2D view.
-        /// \returns pointer to the last pair in list.
-        UserPoint* addUserPoint(cv::Point2f imagePoint, cv::Point2f mappingPoint);
+        /// \returns identifier of the new user point.
+        UserPointId addUserPoint(cv::Point2f imagePoint, cv::Point2f mappingPoint);
 
-        /// Remove UserPoint
-        /// \param point pointer to a existing UserPoint in list of user points.
-        void removeUserPoint(UserPoint* point);
+        /// Remove UserPoint, following user points keep their order.
+        /// \param id identifier of user point.
+        /// \returns false if there is no user point with the identifier.
+        bool removeUserPoint(UserPointId id);
 
         /// Remove all user points.
         void clearUserPoints();
@@ -74,6 +88,11 @@ class PointManager {
         /// \param mappingPoints vector into which mapping points will be inserted.
         void copyImageMappingPoints(std::vector<cv::Point2f>& imagePoints, std::vector<cv::Point2f>& mappingPoints) const;
 
+        /// Find position of user point in arrays of user points.
+        /// \param id identifier of user point.
+        /// \returns index of user point, -1 if there is no user point with the identifier.
+        int findUserPoint(UserPointId id) const;
+
         /// Improve image points position based on given input image.
         /// \param image matrix containing image that will be used to improve points.
         /// \param searchWindowSize specifies a size of window, which is used to improve points. Larger number may have negative impact on performance.
@@ -89,12 +108,36 @@ class PointManager {
         /// \returns scale value.
         const cv::Point2f& getScale() const;
 
-        /// \returns list containing all user points.
-        const std::list<UserPoint>& getUserPoints() const;
+        /// \returns image points of all user points.
+        const std::vector<cv::Point2f>& getUserImagePoints() const;
+
+        /// \returns mapping points of all user points, in the same order as image points.
+        const std::vector<cv::Point2f>& getUserMappingPoints() const;
+
+        /// \returns identifiers of all user points, in the same order as image points.
+        const std::vector<UserPointId>& getUserPointIds() const;
+
+        /// \returns number of user points.
+        std::size_t getUserPointCount() const;
+
+        /// \returns copy of all user points.
+        std::vector<UserPoint> getUserPoints() const;
 
         /// \returns window size.
         const cv::Size& getWindowSize() const;
 
+        /// Move image point of user point.
+        /// \param id identifier of user point.
+        /// \param imagePoint new coordinates of image point.
+        /// \returns false if there is no user point with the identifier.
+        bool setUserImagePoint(UserPointId id, cv::Point2f imagePoint);
+
+        /// Move mapping point of user point.
+        /// \param id identifier of user point.
+        /// \param mappingPoint new coordinates of mapping point.
+        /// \returns false if there is no user point with the identifier.
+        bool setUserMappingPoint(UserPointId id, cv::Point2f mappingPoint);
+
         /// Create new instance of PointManager with predefined points for badminton field mapping.
         /// \param scale defines scale of each point in mapping points.
         /// \param offset defines offset in both x a y axis.
@@ -139,7 +182,15 @@ class PointManager {
 
     protected:
 
-        std::list<UserPoint> m_userPoints;
+        std::vector<cv::Point2f> m_userImagePoints;
+
+        std::vector<cv::Point2f> m_userMappingPoints;
+
+        std::vector<UserPointId> m_userPointIds;
+
+        std::unordered_map<UserPointId, std::size_t> m_userPointIndices;
+
+        UserPointId m_nextUserPointId = 1;
 
         std::vector<cv::Point2f> m_mappingPoints;
 
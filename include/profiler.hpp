@@ -0,0 +1,173 @@
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+/// \class Profiler
+/// \brief Class to record timings of rendering stages.
+///
+/// Class Profiler stores timed events into a ring buffer of
+/// fixed capacity, when the buffer is full the oldest events
+/// are overwritten. Events can be recorded from multiple
+/// threads at once without locking, each event is published
+/// with a sequence number, so a snapshot taken while events
+/// are recorded contains only complete events.
+///
+/// Every event belongs to a frame, which is started by method
+/// beginFrame. Events can be read by method getEvents or
+/// exported in Chrome trace format (chrome://tracing or
+/// Perfetto) by method writeChromeTrace.
+///
+/// Events are recorded by macro IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE,
+/// which is compiled only if IMAGECALIBRATIONLIBRARY_PROFILING is
+/// defined, otherwise it expands to nothing and has no cost.
+///
+
+class Profiler final {
+
+    public:
+
+        /// \struct Event contains single timed event.
+        struct Event {
+
+            const char* category;
+
+            const char* name;
+
+            std::uint64_t frame;
+
+            std::uint32_t thread;
+
+            std::int64_t start;
+
+            std::int64_t duration;
+
+        };
+
+        /// Profiler constructor.
+        /// \param capacity maximal number of stored events, rounded up to power of two.
+        explicit Profiler(std::size_t capacity = 1 << 16);
+
+        Profiler(const Profiler&) = delete;
+
+        Profiler& operator=(const Profiler&) = delete;
+
+        /// Start new frame, following events belong to this frame.
+        /// \returns index of the new frame.
+        std::uint64_t beginFrame();
+
+        /// \returns index of the current frame.
+        std::uint64_t getFrame() const;
+
+        /// \returns time in nanoseconds since the profiler was created.
+        std::int64_t now() const;
+
+        /// Store event into ring buffer.
+        /// \param category category of event, has to be a string with static storage duration.
+        /// \param name name of event, has to be a string with static storage duration.
+        /// \param frame frame of event.
+        /// \param start start of event in nanoseconds returned by method now.
+        /// \param duration duration of event in nanoseconds.
+        void record(const char* category, const char* name, std::uint64_t frame, std::int64_t start, std::int64_t duration);
+
+        /// Returns events, which are stored in ring buffer, ordered from the oldest.
+        /// \returns vector containing events.
+        std::vector<Event> getEvents() const;
+
+        /// Remove all events.
+        void clear();
+
+        /// Write events in Chrome trace event format.
+        /// \param stream output stream.
+        void writeChromeTrace(std::ostream& stream) const;
+
+    private:
+
+        /// \struct Slot of ring buffer, fields are atomic so they can be read while being written.
+        struct Slot {
+
+            std::atomic<std::uint64_t> sequence { 0 };
+
+            std::atomic<const char*> category { nullptr };
+
+            std::atomic<const char*> name { nullptr };
+
+            std::atomic<std::uint64_t> frame { 0 };
+
+            std::atomic<std::uint32_t> thread { 0 };
+
+            std::atomic<std::int64_t> start { 0 };
+
+            std::atomic<std::int64_t> duration { 0 };
+
+        };
+
+        std::size_t m_capacity;
+
+        std::unique_ptr<Slot[]> m_slots;
+
+        std::atomic<std::uint64_t> m_writeIndex { 0 };
+
+        std::atomic<std::uint64_t> m_frame { 0 };
+
+        std::int64_t m_origin;
+
+};
+
+/// \class ProfileScope
+/// \brief Records event, which lasts from construction to destruction of the object.
+class ProfileScope final {
+
+    public:
+
+        /// ProfileScope constructor.
+        /// \param profiler profiler, into which the event is recorded.
+        /// \param category category of event, has to be a string with static storage duration.
+        /// \param name name of event, has to be a string with static storage duration.
+        ProfileScope(Profiler& profiler, const char* category, const char* name)
+            : m_profiler { profiler }
+            , m_category { category }
+            , m_name { name }
+            , m_frame { profiler.getFrame() }
+            , m_start { profiler.now() }
+        {
+        }
+
+        ~ProfileScope() {
+
+            m_profiler.record(m_category, m_name, m_frame, m_start, m_profiler.now() - m_start);
+
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+
+        Profiler& m_profiler;
+
+        const char* m_category;
+
+        const char* m_name;
+
+        std::uint64_t m_frame;
+
+        std::int64_t m_start;
+
+};
+
+#define IMAGECALIBRATIONLIBRARY_CONCAT_(a, b) a##b
+#define IMAGECALIBRATIONLIBRARY_CONCAT(a, b) IMAGECALIBRATIONLIBRARY_CONCAT_(a, b)
+
+#if defined(IMAGECALIBRATIONLIBRARY_PROFILING)
+#define IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(profiler, category, name) \
+    ProfileScope IMAGECALIBRATIONLIBRARY_CONCAT(profileScope, __LINE__)((profiler), (category), (name))
+#else
+#define IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(profiler, category, name) static_cast<void>(0)
+#endif
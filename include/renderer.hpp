@@ -3,8 +3,13 @@
 
 #include "context.hpp"
 #include "drawable.hpp"
+#include "drawableStore.hpp"
+#include "profiler.hpp"
 
+#include <cstdint>
 #include <memory>
+#include <ostream>
+#include <string>
 #include <vector>
 
 /// \class Renderer
@@ -22,58 +27,498 @@
 /// calling method addDrawable. All drawables can be rendered by
 /// calling method render.
 ///
+/// Drawables are owned by DrawableStore. Method insertDrawable
+/// returns handle, which stays valid until the drawable is removed
+/// and is detected as stale afterwards. Adding, removing and looking
+/// up drawables by handle takes constant time. Drawables are drawn
+/// in order of insertion, which can be changed by setDrawOrder.
+///
+/// Drawables are split into named layers, each layer has its own
+/// context and layers are blended in ascending order. Drawables
+/// added without layer name belong to layer defaultLayerName with
+/// order 0. Static layer is drawn into its premultiplied context only
+/// in regions, where its drawables or their homography changed, and
+/// the context is blended again every frame. Changed regions are drawn
+/// the same way as damaged regions, so the cached layer is identical
+/// to the layer drawn as a whole. Static layers below all
+/// other layers are blended with background image into a cached base
+/// image, which replaces background image in following frames, so the
+/// cost of a frame depends only on the other layers.
+///
 /// When an instance of renderer is created a setBackgroundImage
 /// method needs to be called to set a background image that
 /// will be used to create the final image.
+///
+/// Background image, output image, contexts and scratch canvas
+/// are kept between frames and are allocated again only when the
+/// size of the background image changes. Number of these frame
+/// buffer allocations can be obtained by calling method
+/// getAllocationStats, in steady state none are made. Bins of tiles
+/// and lists of covered tiles are reused as well, but they are not
+/// counted, the same as temporary images of drawables, such as
+/// warped pictures of Image.
+///
+/// If damage tracking is enabled, renderer remembers bounding
+/// box and version of each drawable from the previous frame.
+/// Only regions of drawables that were added, removed or
+/// changed are cleared, redrawn and blended with background,
+/// rest of the output image is reused from the previous frame.
+/// OpenCV clips shapes to the image they are drawn into and
+/// antialiased edges of clipped shapes differ, so drawables
+/// crossing border of the region are drawn whole into a scratch
+/// canvas and only the region is copied back. Output is the same
+/// as if the whole frame was rendered.
+///
+/// Before anything is drawn, geometry of all drawables is
+/// prepared in parallel, each drawable is a separate task
+/// of the worker pool. Drawing then only reads the prepared
+/// geometry.
+///
+/// If parallel rendering is enabled, the rendered region is split
+/// into square tiles. Drawables inside a single tile are binned into
+/// the tile and tiles are drawn on worker threads. Drawables spanning
+/// several tiles, such as lines across the whole court, are drawn
+/// only once over the whole region, so their cost does not grow with
+/// the number of tiles. Drawables are drawn in batches, which keep
+/// order of overlapping drawables, so the output is identical to the
+/// serial rendering. Blending is done in parallel in both modes.
+///
+/// Only tiles of context, which are marked in its coverage map,
+/// are cleared and blended, so the cost of blending depends on
+/// the area covered by drawables. Context can also store colors
+/// premultiplied by alpha, which makes blending cheaper and
+/// avoids light fringes around antialiased edges.
+///
+/// Method renderOnto blends drawables directly into a frame owned
+/// by the caller, which can be in BGR, NV12 or I420 format. The
+/// frame is not converted to BGRA and no background image or
+/// output image is used.
+///
+/// If the library is compiled with IMAGECALIBRATIONLIBRARY_PROFILING
+/// defined, renderer records duration of every stage of a frame
+/// and duration of preparing and drawing of every drawable into
+/// a ring buffer of class Profiler. Timings of the last frame are
+/// summarized by method getStats and recorded events can be
+/// exported in Chrome trace format by method writeChromeTrace.
+/// Without the definition no timings are recorded.
 
 class Renderer final {
 
     public:
 
+        /// FrameFormat specifies layout of frame passed to method renderOnto.
+        enum class FrameFormat {
+
+            BGR, NV12, I420
+
+        };
+
+        /// \struct AllocationStats contains number of allocated frame buffers, which are
+        /// output image, base image, contexts of layers and scratch canvas. Other
+        /// allocations, such as temporary images of drawables, are not counted.
+        struct AllocationStats {
+
+            std::uint64_t frameCount = 0;
+
+            std::uint64_t allocationCount = 0;
+
+            std::uint64_t allocatedBytes = 0;
+
+            std::uint64_t frameAllocationCount = 0;
+
+        };
+
+        /// \struct StageStats contains time spent in one stage of a frame.
+        struct StageStats {
+
+            const char* name;
+
+            std::uint64_t count = 0;
+
+            double milliseconds = 0.0;
+
+        };
+
+        /// \struct DrawableStats contains time spent with drawables of one type.
+        struct DrawableStats {
+
+            const char* typeName;
+
+            std::uint64_t prepareCount = 0;
+
+            double prepareMilliseconds = 0.0;
+
+            std::uint64_t drawCount = 0;
+
+            double drawMilliseconds = 0.0;
+
+        };
+
+        /// \struct Stats contains timings of the last rendered frame.
+        struct Stats {
+
+            std::uint64_t frame = 0;
+
+            double frameMilliseconds = 0.0;
+
+            std::vector<StageStats> stages;
+
+            std::vector<DrawableStats> drawables;
+
+            AllocationStats allocations;
+
+        };
+
+        /// Name of layer, which contains drawables added without layer name.
+        static constexpr const char* defaultLayerName = "default";
+
+        /// Renderer constructor.
+        Renderer();
+
         /// Render all drawables to image.
         void render();
 
+        /// Render all drawables directly into frame. Background image is not used.
+        /// \param frame matrix containing frame, CV_8UC3 for BGR or CV_8UC1 with height * 3 / 2 rows for NV12 and I420.
+        /// \param format layout of the frame.
+        void renderOnto(cv::Mat frame, FrameFormat format = FrameFormat::BGR);
+
         /// Add drawable into renderer.
         /// \param drawable pointer to drawable instance.
         /// \returns pointer to the last object in list of drawables.
         Drawable* addDrawable(std::unique_ptr<Drawable> drawable);
 
+        /// Add drawable into renderer.
+        /// \param drawable pointer to drawable instance.
+        /// \returns handle of the drawable.
+        DrawableHandle insertDrawable(std::unique_ptr<Drawable> drawable);
+
+        /// Add drawable into layer.
+        /// \param drawable pointer to drawable instance.
+        /// \param layer name of layer.
+        /// \returns handle of the drawable, null handle if there is no layer with the name.
+        DrawableHandle insertDrawable(std::unique_ptr<Drawable> drawable, const std::string& layer);
+
+        /// Add new layer.
+        /// \param name name of layer.
+        /// \param order layers with smaller order are drawn first, layers with the same order in order of creation.
+        /// \param isStatic if set to true, layer is cached between frames.
+        /// \returns false if layer with the name already exists.
+        bool addLayer(const std::string& name, int order, bool isStatic = false);
+
+        /// Remove layer together with its drawables. Default layer can not be removed.
+        /// \param name name of layer.
+        /// \returns false if the layer was not removed.
+        bool removeLayer(const std::string& name);
+
+        /// \returns names of all layers in draw order.
+        std::vector<std::string> getLayerNames() const;
+
+        /// \param name name of layer.
+        /// \returns order of layer, 0 if there is no layer with the name.
+        int getLayerOrder(const std::string& name) const;
+
+        /// Set order of layer.
+        /// \param name name of layer.
+        /// \param order layers with smaller order are drawn first.
+        /// \returns false if there is no layer with the name.
+        bool setLayerOrder(const std::string& name, int order);
+
+        /// \param name name of layer.
+        /// \returns true if layer is cached between frames.
+        bool isLayerStatic(const std::string& name) const;
+
+        /// Enable or disable caching of layer between frames.
+        /// \param name name of layer.
+        /// \param isStatic if set to true, layer is drawn only where its drawables changed.
+        /// \returns false if there is no layer with the name.
+        bool setLayerStatic(const std::string& name, bool isStatic);
+
         /// Remove all drawables from renderer.
         void clearDrawables();
 
         /// This method returns vector of pointers, that can be
         /// used to get data from each drawable instance and
         /// also enables user to edit each drawble.
-        /// \returns vector containing drawables.
-        std::vector<std::unique_ptr<Drawable>>& getDrawables();
+        /// \returns vector containing drawables in draw order.
+        const std::vector<std::unique_ptr<Drawable>>& getDrawables();
+
+        /// \param handle handle of drawable.
+        /// \returns pointer to drawable, null if the drawable was removed.
+        Drawable* getDrawable(DrawableHandle handle) const;
+
+        /// \param drawable pointer to drawable.
+        /// \returns handle of drawable, null handle if drawable is not in renderer.
+        DrawableHandle getDrawableHandle(const Drawable* drawable) const;
 
         /// Removes single drawable from list of drawables.
         /// \param drawable pointer to drawable.
         void removeDrawable(Drawable* drawable);
 
+        /// Removes single drawable from list of drawables.
+        /// \param handle handle of drawable.
+        /// \returns false if the drawable was already removed.
+        bool removeDrawable(DrawableHandle handle);
+
+        /// \param handle handle of drawable.
+        /// \returns draw order of drawable.
+        std::int64_t getDrawOrder(DrawableHandle handle) const;
+
+        /// Set draw order of drawable, drawables with smaller order are drawn first.
+        /// \param handle handle of drawable.
+        /// \param order draw order of drawable.
+        /// \returns false if the drawable was already removed.
+        bool setDrawOrder(DrawableHandle handle, std::int64_t order);
+
+        /// \returns true if only changed regions are rendered.
+        bool getDamageTracking() const;
+
+        /// Enable or disable rendering of changed regions only.
+        /// \param enabled if set to true, only regions of changed drawables are rendered.
+        void setDamageTracking(bool enabled);
+
+        /// \returns true if drawables are rendered in tiles on multiple threads.
+        bool getParallelRendering() const;
+
+        /// Enable or disable rendering in tiles on multiple threads.
+        /// \param enabled if set to true, tiles are rendered in parallel.
+        void setParallelRendering(bool enabled);
+
+        /// \returns true if context stores colors premultiplied by alpha.
+        bool getPremultipliedAlpha() const;
+
+        /// Enable or disable premultiplied alpha in context.
+        /// \param enabled if set to true, colors in context are premultiplied by alpha.
+        void setPremultipliedAlpha(bool enabled);
+
+        /// \returns size of tile side in pixels.
+        int getTileSize() const;
+
+        /// Set size of tiles used by parallel rendering.
+        /// \param tileSize size of tile side in pixels, rounded to even number.
+        void setTileSize(int tileSize);
+
+        /// Returns statistics of frame buffer allocations. Allocations made
+        /// in setBackgroundImage are counted to the following frame.
+        /// \returns number of rendered frames, total number and size of allocations
+        /// and number of allocations of the last rendered frame.
+        const AllocationStats& getAllocationStats() const;
+
+        /// Reset statistics of frame buffer allocations.
+        void resetAllocationStats();
+
+        /// Returns timings of the last rendered frame. Stages running on
+        /// worker threads are summed over all threads, so their time can
+        /// exceed time of the frame. Timings are empty, if the library is
+        /// compiled without profiling. Method should not be called while
+        /// a frame is rendered.
+        /// \returns timings of stages and drawable types and allocation statistics.
+        Stats getStats() const;
+
+        /// Write events recorded by profiler in Chrome trace format.
+        /// \param stream output stream.
+        void writeChromeTrace(std::ostream& stream) const;
+
         /// Returns background image that is for rendering.
         /// \returns matrix containing background image.
         cv::Mat getBackgroundImage() const;
 
-        /// Returns image that contains rendered drawables.
+        /// Returns image that contains rendered drawables. Returned
+        /// image is reused and overwritten by the next frame. Image
+        /// without background is premultiplied, if premultiplied
+        /// alpha is enabled, and contains only drawables of the default
+        /// layer.
         /// \param includeBackground if set to true, lines will be rendered into inserted image.
         /// \returns matrix containing either background image or objects on alpha background.
         cv::Mat getOutputImage(bool includeBackground = true) const;
 
         /// Sets the background image, which is used for rendering.
         /// this method has to be called right after instance of
-        /// Renderer class is created.
+        /// Renderer class is created. Context is kept, if the size
+        /// of the background image does not change.
         /// \param image matrix, containing input image.
         void setBackgroundImage(cv::Mat image);
 
     private:
 
-        std::unique_ptr<Context> m_context;
+        /// \struct DamageRecord is used to store state of drawable from the previous frame.
+        struct DamageRecord {
+
+            std::uint64_t version = 0;
+
+            std::uint64_t homographyVersion = 0;
+
+            cv::Rect bounds;
+
+            std::uint32_t generation = 0;
+
+        };
+
+        /// \struct Layer is used to store context and drawables of layer.
+        struct Layer {
+
+            std::string name;
+
+            int order = 0;
+
+            bool isStatic = false;
+
+            std::unique_ptr<Context> context;
+
+            std::vector<std::size_t> drawables;
+
+            std::vector<DamageRecord> damageRecords;
+
+            std::vector<DamageRecord> previousDamageRecords;
+
+            bool cached = false;
+
+        };
+
+        /// Start new frame of profiler.
+        void beginFrame();
+
+        /// Find drawables of each layer, drawables keep their draw order inside layer.
+        void assignDrawables();
+
+        /// \returns layer with the name, null if there is no such layer.
+        Layer* findLayer(const std::string& name) const;
+
+        /// Sort layers by their order and find static layers, which are part of base image.
+        void sortLayers();
+
+        /// Draw changed regions of static layers into their contexts.
+        /// \param baseDamage union of changed regions of layers, which are part of base image.
+        /// \returns union of changed regions of other static layers.
+        cv::Rect updateStaticLayers(cv::Rect& baseDamage);
+
+        /// Blend static layers below other layers with background image inside the region.
+        /// \param damage region of base image, which changed.
+        void updateBaseImage(cv::Rect damage);
+
+        /// Compare drawables of layer with records from the previous frame and update the records.
+        /// \param layer layer of compared drawables.
+        /// \returns bounding box of regions, which changed since the previous frame.
+        cv::Rect findDamage(Layer& layer);
+
+        /// Recompute outdated geometry of all drawables in parallel.
+        void prepareDrawables();
+
+        /// Create new contexts of layers, if there are none or if their size or alpha mode differs.
+        /// \param size required size of contexts.
+        void reserveContext(const cv::Size& size);
+
+        /// Create new context of layer, if there is none or if its size or alpha mode differs.
+        /// \param layer layer of context.
+        /// \param size required size of context.
+        void reserveContext(Layer& layer, const cv::Size& size);
+
+        /// Blend region of context into output image or into frame passed to renderOnto.
+        /// \param context blended context.
+        /// \param region blended region.
+        /// \param tiles reused buffer for covered tiles of the region.
+        void composite(const Context& context, const cv::Rect& region, std::vector<cv::Rect>& tiles);
+
+        /// Allocate buffer only if its size or type differs.
+        /// \param buffer reused buffer.
+        /// \param size required size of buffer.
+        /// \param type required type of buffer.
+        void reserveBuffer(cv::Mat& buffer, const cv::Size& size, int type);
+
+        /// Render the whole context and blend it with background image.
+        void renderFull();
+
+        /// Render only regions, which changed since the previous frame.
+        /// \param staticDamage changed regions of static layers and base image.
+        void renderDamage(const cv::Rect& staticDamage);
+
+        /// Draw drawables of layer inside the region and blend it with output image.
+        /// Region of the context has to be cleared and region of the output
+        /// image has to contain background image and layers below.
+        /// \param layer rendered layer.
+        /// \param region region of the output image, that will be rendered.
+        /// \param blend if set to false, drawables are only drawn into context of layer.
+        void renderRegion(Layer& layer, const cv::Rect& region, bool blend = true);
+
+        /// Draw drawables binned into tiles in parallel and then drawables spanning several tiles, bins are cleared.
+        /// \param context context of layer.
+        /// \param region rendered region.
+        /// \param columns number of tile columns in the region.
+        /// \param tileCount number of tiles in the region, zero if tiles are not used.
+        void drawBatch(Context& context, const cv::Rect& region, int columns, std::size_t tileCount);
+
+        /// Find region of scratch canvas, which contains the region and every drawable crossing it.
+        /// \param drawables positions of drawables drawn into the region.
+        /// \param region rendered region.
+        /// \returns region of canvas, which is the whole frame if a drawable crosses border of the frame.
+        cv::Rect findCanvas(const std::vector<std::size_t>& drawables, const cv::Rect& region) const;
+
+        /// Allocate canvas only if it is smaller than the size.
+        /// \param canvas reused canvas.
+        /// \param size required size of canvas.
+        void reserveCanvas(cv::Mat& canvas, const cv::Size& size);
+
+        /// Draw drawables into region of context, the result is the same as if the whole context was drawn.
+        /// Drawables crossing border of the region are drawn into canvas and only the region is copied back.
+        /// \param context context of layer.
+        /// \param drawables positions of drawables in draw order.
+        /// \param region drawn region.
+        /// \param canvasRegion region returned by findCanvas.
+        /// \param canvas buffer at least of the size of canvasRegion.
+        void drawRegion(Context& context, const std::vector<std::size_t>& drawables, const cv::Rect& region, const cv::Rect& canvasRegion, cv::Mat canvas);
+
+        /// Store state of all drawables of layer, which is used to find changed regions in the next frame.
+        /// \param layer layer of drawables.
+        void updateDamageRecords(Layer& layer);
+
+        cv::Size m_size;
 
         cv::Mat m_backgroundImage;
 
+        cv::Mat m_baseImage;
+
         cv::Mat m_outputImage;
 
-        std::vector<std::unique_ptr<Drawable>> m_drawables;
+        cv::Mat m_targetFrame;
+
+        cv::Mat m_canvas;
+
+        std::vector<cv::Rect> m_coveredTiles;
+
+        std::vector<std::vector<std::size_t>> m_tiles;
+
+        std::vector<std::size_t> m_occupiedTiles;
+
+        std::vector<std::size_t> m_spanningDrawables;
+
+        FrameFormat m_targetFormat = FrameFormat::BGR;
+
+        DrawableStore m_drawables;
+
+        std::vector<std::unique_ptr<Layer>> m_layers;
+
+        std::vector<Layer*> m_drawableLayers;
+
+        Layer* m_defaultLayer;
+
+        std::size_t m_baseLayerCount = 0;
+
+        bool m_baseValid = false;
+
+        bool m_damageTracking = false;
+
+        bool m_fullDamage = true;
+
+        bool m_parallelRendering = false;
+
+        bool m_premultipliedAlpha = false;
+
+        AllocationStats m_allocationStats;
+
+        std::uint64_t m_pendingAllocationCount = 0;
+
+        std::unique_ptr<Profiler> m_profiler;
+
+        int m_tileSize = 256;
 
 };
@@ -5,10 +5,25 @@
 
 class Homography;
 
-/// This function is used to blend 2 images containing alpha channel.
+/// This function is used to blend image containing alpha channel into BGRA or BGR image.
 /// \param destinationImage matrix containing 1st image to blend. Output of this function is written into this matrix.
-/// \param sourceImage matrix containing 2nd image to blend.
-void blendImages(cv::Mat destinationImage, cv::Mat sourceImage);
+/// \param sourceImage matrix containing 2nd image to blend, which has to contain alpha channel.
+/// \param premultiplied if set to true, color channels of source image are premultiplied by alpha.
+void blendImages(cv::Mat destinationImage, cv::Mat sourceImage, bool premultiplied = false);
+
+/// Blend image containing alpha channel into frame in NV12 format in place.
+/// \param frame matrix (CV_8UC1) with height * 3 / 2 rows, containing Y plane followed by interleaved UV plane.
+/// \param sourceImage matrix containing image with alpha channel, which has the size of the frame.
+/// \param region part of the frame to blend, it is extended to even coordinates. Empty region blends the whole frame.
+/// \param premultiplied if set to true, color channels of source image are premultiplied by alpha.
+void blendImagesNV12(cv::Mat frame, cv::Mat sourceImage, cv::Rect region = {}, bool premultiplied = false);
+
+/// Blend image containing alpha channel into frame in I420 format in place.
+/// \param frame continuous matrix (CV_8UC1) with height * 3 / 2 rows, containing Y, U and V planes.
+/// \param sourceImage matrix containing image with alpha channel, which has the size of the frame.
+/// \param region part of the frame to blend, it is extended to even coordinates. Empty region blends the whole frame.
+/// \param premultiplied if set to true, color channels of source image are premultiplied by alpha.
+void blendImagesI420(cv::Mat frame, cv::Mat sourceImage, cv::Rect region = {}, bool premultiplied = false);
 
 /// Converts BGR image to BGRA.
 /// \param inputImage without alpha channel.
@@ -22,9 +37,32 @@ cv::Mat convertBGRtoBGRA(cv::Mat inputImage);
 /// \returns matrix containing transformed input.
 cv::Mat computeBirdsEyeView(cv::Mat homography, cv::Mat image, const cv::Size& windowSize);
 
-/// Function to remove barrel and pincushion distortion.
+/// Transform image into birds eye view using remap tables cached in homography.
+/// This function should be preferred if multiple images are transformed with the same homography.
+/// \param homography instance of class Homography with homography matrix inserted.
+/// \param image matrix containing image that will be transformed.
+/// \param windowSize size of the mapping window, this can be obtained from PointManager using method calculateWindowSize and getWindowSize.
+/// \returns matrix containing transformed input.
+cv::Mat computeBirdsEyeView(const Homography& homography, cv::Mat image, const cv::Size& windowSize);
+
+/// Compute map, which is used to remove barrel and pincushion distortion with cv::remap.
+/// \param size size of distorted image.
+/// \param k distortion coefficient, set k positiove to remove barrel distortion and negative to remove pincushion distortion.
+/// \param scale is used to scale the input image to get rid of black background, which is caused by removing distortion.
+/// \returns matrix (CV_16SC2) containing coordinates of input pixel for each output pixel.
+cv::Mat computeUndistortMap(const cv::Size& size, double k, double scale);
+
+/// Function to remove barrel and pincushion distortion. Map for each combination of
+/// size, k and scale is computed once and cached. Image can have 1, 3 or 4 channels.
 /// \param input matrix containing distorted image.
 /// \param k distortion coefficient, set k positiove to remove barrel distortion and negative to remove pincushion distortion.
 /// \param scale is used to scale the input image to get rid of black background, which is caused by removing distortion.
 /// \returns matrix containing undistorted and scaled image.
 cv::Mat undistort(cv::Mat input, double k, double scale);
+
+/// Function to remove barrel and pincushion distortion into existing matrix, which is reused if it has the right size and type.
+/// \param input matrix containing distorted image.
+/// \param output matrix into which undistorted and scaled image will be inserted.
+/// \param k distortion coefficient, set k positiove to remove barrel distortion and negative to remove pincushion distortion.
+/// \param scale is used to scale the input image to get rid of black background, which is caused by removing distortion.
+void undistort(cv::Mat input, cv::Mat& output, double k, double scale);
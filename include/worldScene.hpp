@@ -0,0 +1,133 @@
+
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/// \class WorldScene
+/// \brief Class to store shapes defined in mapping plane.
+///
+/// Class WorldScene contains shapes, such as court lines or
+/// markers of players, with coordinates in mapping plane instead
+/// of image. The scene does not depend on any homography, so one
+/// scene can be drawn into any number of camera views by class
+/// SceneView or by class MultiViewRenderer.
+///
+/// Every shape is a polyline, which is stored relative to position
+/// of the shape. Circles are sampled into polylines once, when they
+/// are added, so moving a shape by setPosition or setPositions only
+/// changes its position. Negative thickness draws filled shapes.
+///
+/// Method prepare computes points of all shapes in mapping plane
+/// and stores them in a single contiguous array. Points are computed
+/// again only if the scene changed since the last call, so the work
+/// in mapping plane is done once per frame regardless of number of
+/// views. Method prepare can be called concurrently by views, but
+/// the scene must not be changed while it is being rendered.
+///
+
+class WorldScene final {
+
+    public:
+
+        /// \struct Shape contains attributes of one shape and range of its points.
+        struct Shape {
+
+            cv::Point2f position;
+
+            cv::Scalar color;
+
+            float alpha = 1.0f;
+
+            int thickness = 1;
+
+            bool closed = false;
+
+            std::size_t begin = 0;
+
+            std::size_t end = 0;
+
+        };
+
+        /// Add circle into scene.
+        /// \param center center point in mapping plane.
+        /// \param radius radius in mapping plane.
+        /// \param color BGR color.
+        /// \param thickness line thickness, negative value draws filled circle.
+        /// \param alpha transparency in range [0, 1].
+        /// \returns index of the shape.
+        std::size_t addCircle(cv::Point2f center, float radius, cv::Scalar color, int thickness = 1, float alpha = 1.0f);
+
+        /// Add polyline into scene.
+        /// \param points points in mapping plane.
+        /// \param closed if set to true, the last point is connected to the first one.
+        /// \param color BGR color.
+        /// \param thickness line thickness, negative value draws filled polygon.
+        /// \param alpha transparency in range [0, 1].
+        /// \returns index of the shape.
+        std::size_t addPolyline(const std::vector<cv::Point2f>& points, bool closed, cv::Scalar color, int thickness = 1, float alpha = 1.0f);
+
+        /// Remove all shapes from scene.
+        void clear();
+
+        /// \returns points of all shapes in mapping plane computed by method prepare.
+        const std::vector<cv::Point2f>& getPoints() const;
+
+        /// \param shape index of the shape.
+        /// \returns position of the shape in mapping plane.
+        cv::Point2f getPosition(std::size_t shape) const;
+
+        /// \returns number of shapes.
+        std::size_t getShapeCount() const;
+
+        /// \returns shapes of the scene.
+        const std::vector<Shape>& getShapes() const;
+
+        /// \returns version of the scene, which is increased every time the scene is changed.
+        std::uint64_t getVersion() const;
+
+        /// Compute points of all shapes in mapping plane if the scene changed.
+        void prepare();
+
+        /// Set transparency of shape.
+        /// \param shape index of the shape.
+        /// \param alpha transparency in range [0, 1].
+        void setAlpha(std::size_t shape, float alpha);
+
+        /// Set color of shape.
+        /// \param shape index of the shape.
+        /// \param color BGR color.
+        void setColor(std::size_t shape, cv::Scalar color);
+
+        /// Set position of shape.
+        /// \param shape index of the shape.
+        /// \param position position in mapping plane.
+        void setPosition(std::size_t shape, cv::Point2f position);
+
+        /// Set positions of consecutive shapes.
+        /// \param positions positions in mapping plane.
+        /// \param count number of positions.
+        /// \param first index of the first shape.
+        void setPositions(const cv::Point2f* positions, std::size_t count, std::size_t first = 0);
+
+    private:
+
+        /// \returns index of the new shape.
+        std::size_t addShape(Shape shape);
+
+        std::vector<Shape> m_shapes;
+
+        std::vector<cv::Point2f> m_localPoints;
+
+        std::vector<cv::Point2f> m_points;
+
+        std::uint64_t m_version = 1;
+
+        std::uint64_t m_preparedVersion = 0;
+
+        std::mutex m_mutex;
+
+};
@@ -3,15 +3,87 @@
 
 #include "drawable.hpp"
 
-Context::Context(cv::Size size)
+Context::Context(cv::Size size, bool premultiplied)
     : m_size { std::move(size) }
-    , m_image { m_size.height, m_size.width, CV_8UC4, { 255, 255, 255, 0 } }
+    , m_clip { 0, 0, m_size.width, m_size.height }
+    , m_premultiplied { premultiplied }
+    , m_coverageColumns { (m_size.width + coverageTileSize - 1) / coverageTileSize }
+    , m_coverageRows { (m_size.height + coverageTileSize - 1) / coverageTileSize }
+    , m_coverage { std::make_shared<std::vector<std::atomic<std::uint8_t>>>(static_cast<std::size_t>(m_coverageColumns) * m_coverageRows) }
+{
+
+    m_image = cv::Mat(m_size.height, m_size.width, CV_8UC4, getClearColor());
+
+}
+
+Context::Context(const Context& context, const cv::Rect& clip)
+    : m_size { context.m_size }
+    , m_image { context.m_image }
+    , m_clip { clip & cv::Rect(0, 0, m_size.width, m_size.height) }
+    , m_premultiplied { context.m_premultiplied }
+    , m_coverageColumns { context.m_coverageColumns }
+    , m_coverageRows { context.m_coverageRows }
+    , m_coverage { context.m_coverage }
+{
+}
+
+Context::Context(const Context& context, const cv::Rect& clip, cv::Mat image)
+    : m_size { context.m_size }
+    , m_image { std::move(image) }
+    , m_clip { clip & cv::Rect(0, 0, m_size.width, m_size.height) }
+    , m_origin { m_clip.tl() }
+    , m_premultiplied { context.m_premultiplied }
+    , m_coverageColumns { context.m_coverageColumns }
+    , m_coverageRows { context.m_coverageRows }
 {
 }
 
 void Context::clear() {
 
-    m_image = cv::Mat(m_image.rows, m_image.cols, m_image.type(), {255,255,255,0});
+    if (!m_coverage) {
+        m_image.setTo(getClearColor());
+        return;
+    }
+
+    // Tiles, which were not marked, still contain only transparent pixels.
+    for (int row = 0; row < m_coverageRows; row++)
+        for (int column = 0; column < m_coverageColumns; column++) {
+
+            std::atomic<std::uint8_t>& covered = (*m_coverage)[row * m_coverageColumns + column];
+
+            if (!covered.load(std::memory_order_relaxed))
+                continue;
+
+            m_image(getTile(column, row)).setTo(getClearColor());
+
+            covered.store(0, std::memory_order_relaxed);
+
+        }
+
+}
+
+void Context::clear(const cv::Rect& region) {
+
+    const cv::Rect clipped = region & cv::Rect(m_origin, m_image.size());
+
+    if (clipped.empty())
+        return;
+
+    m_image(clipped - m_origin).setTo(getClearColor());
+
+    if (!m_coverage)
+        return;
+
+    // Only tiles inside the region become transparent, other tiles can have content outside of it.
+    for (int row = clipped.y / coverageTileSize; row <= (clipped.y + clipped.height - 1) / coverageTileSize; row++)
+        for (int column = clipped.x / coverageTileSize; column <= (clipped.x + clipped.width - 1) / coverageTileSize; column++) {
+
+            const cv::Rect tile = getTile(column, row);
+
+            if ((tile & clipped) == tile)
+                (*m_coverage)[row * m_coverageColumns + column].store(0, std::memory_order_relaxed);
+
+        }
 
 }
 
@@ -19,6 +91,58 @@ void Context::draw(Drawable& drawable) {
 
     drawable.draw(*this);
 
+    markCovered(drawable.getBounds() & m_clip);
+
+}
+
+cv::Scalar Context::getColor(const cv::Scalar& color, float alpha) const {
+
+    if (m_premultiplied)
+        return { color[0] * alpha, color[1] * alpha, color[2] * alpha, 255.0 * alpha };
+
+    return { color[0], color[1], color[2], 255.0 * alpha };
+
+}
+
+std::vector<cv::Rect> Context::getCoveredTiles(const cv::Rect& region) const {
+
+    std::vector<cv::Rect> tiles;
+
+    getCoveredTiles(region, tiles);
+
+    return tiles;
+
+}
+
+void Context::getCoveredTiles(const cv::Rect& region, std::vector<cv::Rect>& tiles) const {
+
+    tiles.clear();
+
+    const cv::Rect clipped = region & cv::Rect(0, 0, m_size.width, m_size.height);
+
+    if (clipped.empty() || !m_coverage)
+        return;
+
+    for (int row = clipped.y / coverageTileSize; row <= (clipped.y + clipped.height - 1) / coverageTileSize; row++)
+        for (int column = clipped.x / coverageTileSize; column <= (clipped.x + clipped.width - 1) / coverageTileSize; column++) {
+
+            if ((*m_coverage)[row * m_coverageColumns + column].load(std::memory_order_relaxed))
+                tiles.push_back(getTile(column, row) & clipped);
+
+        }
+
+}
+
+const cv::Rect& Context::getClip() const {
+
+    return m_clip;
+
+}
+
+cv::Mat Context::getClippedImage() const {
+
+    return m_image(m_clip - m_origin);
+
 }
 
 cv::Mat Context::getImage() const {
@@ -32,3 +156,47 @@ const cv::Size& Context::getSize() const {
     return m_size;
 
 }
+
+bool Context::isPremultiplied() const {
+
+    return m_premultiplied;
+
+}
+
+void Context::markCovered(const cv::Rect& region) {
+
+    const cv::Rect clipped = region & cv::Rect(0, 0, m_size.width, m_size.height);
+
+    if (clipped.empty() || !m_coverage)
+        return;
+
+    for (int row = clipped.y / coverageTileSize; row <= (clipped.y + clipped.height - 1) / coverageTileSize; row++)
+        for (int column = clipped.x / coverageTileSize; column <= (clipped.x + clipped.width - 1) / coverageTileSize; column++)
+            (*m_coverage)[row * m_coverageColumns + column].store(1, std::memory_order_relaxed);
+
+}
+
+void Context::setClip(const cv::Rect& clip) {
+
+    m_clip = clip & cv::Rect(m_origin, m_image.size());
+
+}
+
+void Context::resetClip() {
+
+    m_clip = cv::Rect(m_origin, m_image.size());
+
+}
+
+cv::Scalar Context::getClearColor() const {
+
+    return m_premultiplied ? cv::Scalar(0, 0, 0, 0) : cv::Scalar(255, 255, 255, 0);
+
+}
+
+cv::Rect Context::getTile(int column, int row) const {
+
+    return cv::Rect(column * coverageTileSize, row * coverageTileSize, coverageTileSize, coverageTileSize)
+         & cv::Rect(0, 0, m_size.width, m_size.height);
+
+}
@@ -0,0 +1,610 @@
+
+#include "courtDetector.hpp"
+
+#include "pointManager.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+
+// Minimal brightness of line pixels and minimal difference to pixels on both sides of line.
+constexpr double minLineBrightness = 140.0;
+constexpr double minLineContrast = 20.0;
+
+// Maximal width of court lines in downscaled image.
+constexpr int maxLineWidth = 6;
+
+// Segments are merged into line if their angle and distance to the line are small.
+constexpr float maxAngleDifference = 0.035f;
+constexpr float maxLineDistance = 3.0f;
+
+// Number of samples of each field line used to verify a match.
+constexpr int samplesPerLine = 12;
+
+// Distance in downscaled image, in which intersections of image lines refine projected mapping points.
+constexpr float maxIntersectionDistance = 6.0f;
+
+// Returns coordinates shared by at least two mapping points, which define lines of the field.
+std::vector<float> findFieldLines(const std::vector<cv::Point2f>& mappingPoints, bool horizontal) {
+
+    std::vector<float> coordinates;
+
+    coordinates.reserve(mappingPoints.size());
+
+    for (const cv::Point2f& point : mappingPoints)
+        coordinates.push_back(horizontal ? point.y : point.x);
+
+    std::sort(coordinates.begin(), coordinates.end());
+
+    std::vector<float> lines;
+
+    for (std::size_t i = 0; i + 1 < coordinates.size(); i++) {
+
+        if (coordinates[i + 1] - coordinates[i] > 1e-3f)
+            continue;
+
+        if (lines.empty() || coordinates[i] - lines.back() > 1e-3f)
+            lines.push_back(coordinates[i]);
+
+    }
+
+    return lines;
+
+}
+
+bool intersect(const cv::Vec3f& first, const cv::Vec3f& second, cv::Point2f& point) {
+
+    const float x = first[1] * second[2] - first[2] * second[1];
+    const float y = first[2] * second[0] - first[0] * second[2];
+    const float w = first[0] * second[1] - first[1] * second[0];
+
+    if (std::abs(w) < 1e-6f)
+        return false;
+
+    point = { x / w, y / w };
+
+    return true;
+
+}
+
+// Returns 1 or -1 for convex quadrilateral depending on its orientation, 0 for other quadrilaterals.
+int getOrientation(const cv::Point2f (&quad)[4]) {
+
+    int sign = 0;
+
+    for (int i = 0; i < 4; i++) {
+
+        const cv::Point2f first = quad[(i + 1) % 4] - quad[i];
+        const cv::Point2f second = quad[(i + 2) % 4] - quad[(i + 1) % 4];
+
+        const float cross = first.x * second.y - first.y * second.x;
+
+        if (std::abs(cross) < 1e-3f)
+            return 0;
+
+        const int current = cross > 0.0f ? 1 : -1;
+
+        if (sign != 0 && current != sign)
+            return 0;
+
+        sign = current;
+
+    }
+
+    return sign;
+
+}
+
+cv::Point2f projectPoint(const cv::Matx33d& homography, const cv::Point2f& point) {
+
+    const double w = homography(2, 0) * point.x + homography(2, 1) * point.y + homography(2, 2);
+
+    if (std::abs(w) < DBL_EPSILON)
+        return { -1.0f, -1.0f };
+
+    return { static_cast<float>((homography(0, 0) * point.x + homography(0, 1) * point.y + homography(0, 2)) / w),
+             static_cast<float>((homography(1, 0) * point.x + homography(1, 1) * point.y + homography(1, 2)) / w) };
+
+}
+
+}
+
+bool CourtDetector::detect(const cv::Mat& image, PointManager& pointManager) {
+
+    m_score = 0.0;
+
+    const std::vector<cv::Point2f>& mappingPoints = pointManager.getMappingPoints();
+
+    if (image.empty() || mappingPoints.size() < 4)
+        return false;
+
+    switch (image.channels()) {
+
+        case 1:
+
+            m_gray = image;
+            break;
+
+        case 3:
+
+            cv::cvtColor(image, m_gray, cv::COLOR_BGR2GRAY);
+            break;
+
+        case 4:
+
+            cv::cvtColor(image, m_gray, cv::COLOR_BGRA2GRAY);
+            break;
+
+        default:
+
+            return false;
+
+    }
+
+    m_imageScale = std::min(1.0, static_cast<double>(m_processingWidth) / image.cols);
+
+    if (m_imageScale < 1.0)
+        cv::resize(m_gray, m_gray, cv::Size(), m_imageScale, m_imageScale, cv::INTER_AREA);
+
+    computeLineMask();
+    findLines();
+
+    cv::Matx33d homography;
+
+    if (!matchLines(mappingPoints, homography))
+        return false;
+
+    // Projected mapping points are moved to the closest intersections of image lines.
+    std::vector<cv::Point2f> intersections;
+
+    for (const Line& horizontal : m_horizontalLines)
+        for (const Line& vertical : m_verticalLines) {
+
+            cv::Point2f point;
+
+            if (intersect(horizontal.coefficients, vertical.coefficients, point))
+                intersections.push_back(point);
+
+        }
+
+    std::vector<cv::Point2f> matchedMappingPoints;
+    std::vector<cv::Point2f> matchedImagePoints;
+
+    for (const cv::Point2f& mappingPoint : mappingPoints) {
+
+        const cv::Point2f projected = projectPoint(homography, mappingPoint);
+
+        float bestDistance = maxIntersectionDistance;
+        const cv::Point2f* bestIntersection = nullptr;
+
+        for (const cv::Point2f& intersection : intersections) {
+
+            const float distance = static_cast<float>(cv::norm(intersection - projected));
+
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                bestIntersection = &intersection;
+            }
+
+        }
+
+        if (bestIntersection) {
+            matchedMappingPoints.push_back(mappingPoint);
+            matchedImagePoints.push_back(*bestIntersection);
+        }
+
+    }
+
+    if (matchedMappingPoints.size() >= 4) {
+
+        cv::Mat refined = cv::findHomography(matchedMappingPoints, matchedImagePoints);
+
+        double score = 0.0;
+
+        if (!refined.empty()) {
+
+            refined.convertTo(refined, CV_64F);
+
+            const cv::Matx33d refinedHomography = refined;
+            const double fraction = verify(refinedHomography, score);
+
+            if (fraction >= m_score) {
+                homography = refinedHomography;
+                m_score = fraction;
+            }
+
+        }
+
+    }
+
+    // Mapping points visible in the image become user points.
+    pointManager.clearUserPoints();
+
+    const cv::Rect2f bounds(0.0f, 0.0f, static_cast<float>(image.cols), static_cast<float>(image.rows));
+
+    for (const cv::Point2f& mappingPoint : mappingPoints) {
+
+        const cv::Point2f imagePoint = projectPoint(homography, mappingPoint) * static_cast<float>(1.0 / m_imageScale);
+
+        if (bounds.contains(imagePoint))
+            pointManager.addUserPoint(imagePoint, mappingPoint);
+
+    }
+
+    return true;
+
+}
+
+const cv::Mat& CourtDetector::getLineMask() const {
+
+    return m_lineMask;
+
+}
+
+int CourtDetector::getMaxLines() const {
+
+    return m_maxLines;
+
+}
+
+double CourtDetector::getMinScore() const {
+
+    return m_minScore;
+
+}
+
+int CourtDetector::getProcessingWidth() const {
+
+    return m_processingWidth;
+
+}
+
+double CourtDetector::getScore() const {
+
+    return m_score;
+
+}
+
+void CourtDetector::setMaxLines(int maxLines) {
+
+    m_maxLines = std::max(maxLines, 2);
+
+}
+
+void CourtDetector::setMinScore(double minScore) {
+
+    m_minScore = std::min(std::max(minScore, 0.0), 1.0);
+
+}
+
+void CourtDetector::setProcessingWidth(int width) {
+
+    m_processingWidth = std::max(width, 64);
+
+}
+
+void CourtDetector::computeLineMask() {
+
+    m_lineMask.create(m_gray.size(), CV_8UC1);
+    m_lineMask.setTo(cv::Scalar::all(0));
+
+    const int distance = maxLineWidth;
+
+    if (m_gray.cols <= 2 * distance || m_gray.rows <= 2 * distance) {
+        m_verificationMask = m_lineMask.clone();
+        return;
+    }
+
+    // Line pixels are brighter than pixels in distance of line width on both sides of the line.
+    const cv::Rect center(distance, distance, m_gray.cols - 2 * distance, m_gray.rows - 2 * distance);
+    const cv::Mat pixels = m_gray(center);
+
+    cv::Mat first;
+    cv::Mat second;
+    cv::Mat horizontal;
+    cv::Mat vertical;
+
+    cv::subtract(pixels, m_gray(center - cv::Point(distance, 0)), first);
+    cv::subtract(pixels, m_gray(center + cv::Point(distance, 0)), second);
+    cv::min(first, second, horizontal);
+
+    cv::subtract(pixels, m_gray(center - cv::Point(0, distance)), first);
+    cv::subtract(pixels, m_gray(center + cv::Point(0, distance)), second);
+    cv::min(first, second, vertical);
+
+    cv::max(horizontal, vertical, horizontal);
+
+    cv::Mat lines = m_lineMask(center);
+
+    cv::threshold(horizontal, lines, minLineContrast - 1.0, 255.0, cv::THRESH_BINARY);
+    cv::threshold(pixels, first, minLineBrightness - 1.0, 255.0, cv::THRESH_BINARY);
+    cv::bitwise_and(lines, first, lines);
+
+    // Projected field lines are allowed to miss line pixels by one pixel.
+    cv::dilate(m_lineMask, m_verificationMask, cv::Mat());
+
+}
+
+void CourtDetector::findLines() {
+
+    m_horizontalLines.clear();
+    m_verticalLines.clear();
+
+    const int minLength = std::max(m_lineMask.cols / 20, 10);
+
+    std::vector<cv::Vec4i> segments;
+
+    cv::HoughLinesP(m_lineMask, segments, 1.0, CV_PI / 180.0, minLength, minLength, 2 * maxLineWidth);
+
+    auto getLength = [](const cv::Vec4i& segment) {
+
+        return std::hypot(static_cast<float>(segment[2] - segment[0]), static_cast<float>(segment[3] - segment[1]));
+
+    };
+
+    std::sort(segments.begin(), segments.end(), [&getLength](const cv::Vec4i& first, const cv::Vec4i& second) {
+
+        return getLength(first) > getLength(second);
+
+    });
+
+    // Segments are merged into lines defined by the longest segment of each line.
+    struct Cluster {
+
+        cv::Vec3f coefficients;
+
+        float angle;
+
+        float length;
+
+        std::vector<cv::Point2f> points;
+
+    };
+
+    std::vector<Cluster> clusters;
+
+    for (const cv::Vec4i& segment : segments) {
+
+        const cv::Point2f first(static_cast<float>(segment[0]), static_cast<float>(segment[1]));
+        const cv::Point2f second(static_cast<float>(segment[2]), static_cast<float>(segment[3]));
+
+        const float length = getLength(segment);
+
+        if (length < 1.0f)
+            continue;
+
+        float angle = std::atan2(second.y - first.y, second.x - first.x);
+
+        if (angle < 0.0f)
+            angle += static_cast<float>(CV_PI);
+
+        auto cluster = std::find_if(clusters.begin(), clusters.end(), [&](const Cluster& cluster) {
+
+            const float difference = std::abs(cluster.angle - angle);
+
+            if (std::min(difference, static_cast<float>(CV_PI) - difference) > maxAngleDifference)
+                return false;
+
+            const cv::Vec3f& line = cluster.coefficients;
+
+            return std::abs(line[0] * first.x + line[1] * first.y + line[2]) < maxLineDistance
+                && std::abs(line[0] * second.x + line[1] * second.y + line[2]) < maxLineDistance;
+
+        });
+
+        if (cluster == clusters.end()) {
+
+            const cv::Point2f direction = (second - first) * (1.0f / length);
+
+            clusters.push_back({ { direction.y, -direction.x, direction.x * first.y - direction.y * first.x }, angle, 0.0f, {} });
+
+            cluster = clusters.end() - 1;
+
+        }
+
+        cluster->length += length;
+        cluster->points.push_back(first);
+        cluster->points.push_back(second);
+
+    }
+
+    for (const Cluster& cluster : clusters) {
+
+        cv::Vec4f fitted;
+
+        cv::fitLine(cluster.points, fitted, cv::DIST_L2, 0.0, 0.01, 0.01);
+
+        const Line line { { fitted[1], -fitted[0], fitted[0] * fitted[3] - fitted[1] * fitted[2] }, cluster.length };
+
+        if (std::abs(fitted[0]) > std::abs(fitted[1])) {
+            m_horizontalLines.push_back(line);
+        } else {
+            m_verticalLines.push_back(line);
+        }
+
+    }
+
+    // Only the longest lines are matched, they are ordered by their position in image.
+    const float centerX = m_lineMask.cols * 0.5f;
+    const float centerY = m_lineMask.rows * 0.5f;
+
+    auto keepLongest = [this](std::vector<Line>& lines) {
+
+        std::sort(lines.begin(), lines.end(), [](const Line& first, const Line& second) {
+
+            return first.length > second.length;
+
+        });
+
+        if (lines.size() > static_cast<std::size_t>(m_maxLines))
+            lines.resize(m_maxLines);
+
+    };
+
+    keepLongest(m_horizontalLines);
+    keepLongest(m_verticalLines);
+
+    std::sort(m_horizontalLines.begin(), m_horizontalLines.end(), [centerX](const Line& first, const Line& second) {
+
+        return -(first.coefficients[0] * centerX + first.coefficients[2]) / first.coefficients[1]
+             < -(second.coefficients[0] * centerX + second.coefficients[2]) / second.coefficients[1];
+
+    });
+
+    std::sort(m_verticalLines.begin(), m_verticalLines.end(), [centerY](const Line& first, const Line& second) {
+
+        return -(first.coefficients[1] * centerY + first.coefficients[2]) / first.coefficients[0]
+             < -(second.coefficients[1] * centerY + second.coefficients[2]) / second.coefficients[0];
+
+    });
+
+}
+
+bool CourtDetector::matchLines(const std::vector<cv::Point2f>& mappingPoints, cv::Matx33d& homography) {
+
+    const std::vector<float> fieldRows = findFieldLines(mappingPoints, true);
+    const std::vector<float> fieldColumns = findFieldLines(mappingPoints, false);
+
+    if (fieldRows.size() < 2 || fieldColumns.size() < 2 || m_horizontalLines.size() < 2 || m_verticalLines.size() < 2)
+        return false;
+
+    // Field lines are sampled between the outermost mapping points lying on them.
+    m_samples.clear();
+
+    for (int horizontal = 0; horizontal < 2; horizontal++) {
+
+        for (float coordinate : horizontal ? fieldRows : fieldColumns) {
+
+            float minimum = FLT_MAX;
+            float maximum = -FLT_MAX;
+
+            for (const cv::Point2f& point : mappingPoints) {
+
+                if (std::abs((horizontal ? point.y : point.x) - coordinate) > 1e-3f)
+                    continue;
+
+                minimum = std::min(minimum, horizontal ? point.x : point.y);
+                maximum = std::max(maximum, horizontal ? point.x : point.y);
+
+            }
+
+            for (int i = 0; i < samplesPerLine; i++) {
+
+                const float position = minimum + (maximum - minimum) * i / (samplesPerLine - 1);
+
+                m_samples.push_back(horizontal ? cv::Point2f(position, coordinate) : cv::Point2f(coordinate, position));
+
+            }
+
+        }
+
+    }
+
+    double bestScore = 0.0;
+    double bestFraction = 0.0;
+
+    for (std::size_t i = 0; i < m_horizontalLines.size(); i++)
+    for (std::size_t j = i + 1; j < m_horizontalLines.size(); j++)
+    for (std::size_t k = 0; k < m_verticalLines.size(); k++)
+    for (std::size_t l = k + 1; l < m_verticalLines.size(); l++) {
+
+        cv::Point2f imageQuad[4];
+
+        if (!intersect(m_horizontalLines[i].coefficients, m_verticalLines[k].coefficients, imageQuad[0])
+         || !intersect(m_horizontalLines[i].coefficients, m_verticalLines[l].coefficients, imageQuad[1])
+         || !intersect(m_horizontalLines[j].coefficients, m_verticalLines[l].coefficients, imageQuad[2])
+         || !intersect(m_horizontalLines[j].coefficients, m_verticalLines[k].coefficients, imageQuad[3]))
+            continue;
+
+        const int imageOrientation = getOrientation(imageQuad);
+
+        if (imageOrientation == 0)
+            continue;
+
+        // Horizontal image lines are matched either with rows or with columns of the field.
+        for (int swapped = 0; swapped < 2; swapped++) {
+
+            const std::vector<float>& rows = swapped ? fieldColumns : fieldRows;
+            const std::vector<float>& columns = swapped ? fieldRows : fieldColumns;
+
+            auto corner = [swapped](float row, float column) {
+
+                return swapped ? cv::Point2f(row, column) : cv::Point2f(column, row);
+
+            };
+
+            for (std::size_t a = 0; a < rows.size(); a++)
+            for (std::size_t b = 0; b < rows.size(); b++)
+            for (std::size_t c = 0; c < columns.size(); c++)
+            for (std::size_t d = c + 1; d < columns.size(); d++) {
+
+                if (a == b)
+                    continue;
+
+                const cv::Point2f fieldQuad[4] { corner(rows[a], columns[c]), corner(rows[a], columns[d]), corner(rows[b], columns[d]), corner(rows[b], columns[c]) };
+
+                // Camera looking at the field from above can not mirror it.
+                if (getOrientation(fieldQuad) != imageOrientation)
+                    continue;
+
+                const cv::Matx33d candidate = cv::getPerspectiveTransform(fieldQuad, imageQuad);
+
+                double score = 0.0;
+
+                const double fraction = verify(candidate, score);
+
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestFraction = fraction;
+                    homography = candidate;
+                }
+
+            }
+
+        }
+
+    }
+
+    if (bestScore < 2 * samplesPerLine || bestFraction < m_minScore)
+        return false;
+
+    m_score = bestFraction;
+
+    return true;
+
+}
+
+double CourtDetector::verify(const cv::Matx33d& homography, double& score) const {
+
+    int inside = 0;
+    int hits = 0;
+
+    for (const cv::Point2f& sample : m_samples) {
+
+        const double w = homography(2, 0) * sample.x + homography(2, 1) * sample.y + homography(2, 2);
+
+        // Points behind the camera can not be visible.
+        if (w <= DBL_EPSILON)
+            continue;
+
+        const int x = cvRound((homography(0, 0) * sample.x + homography(0, 1) * sample.y + homography(0, 2)) / w);
+        const int y = cvRound((homography(1, 0) * sample.x + homography(1, 1) * sample.y + homography(1, 2)) / w);
+
+        if (x < 0 || y < 0 || x >= m_verificationMask.cols || y >= m_verificationMask.rows)
+            continue;
+
+        inside++;
+
+        if (m_verificationMask.ptr<unsigned char>(y)[x])
+            hits++;
+
+    }
+
+    // Samples, which miss line pixels, are penalized, so projections of the field into empty regions are not preferred.
+    score = hits - 0.5 * (inside - hits);
+
+    return inside > 0 ? static_cast<double>(hits) / inside : 0.0;
+
+}
@@ -1,10 +1,14 @@
 
 #include "drawable.hpp"
+
+#include "homography.hpp"
 
 #include <algorithm>
+#include <atomic>
 
 Drawable::Drawable(std::shared_ptr<Homography> homography)
     : m_homography { std::move(homography) }
+    , m_version { nextVersion() }
 {
 }
 
@@ -14,32 +18,108 @@ float Drawable::getAlpha() const {
 
 }
 
+cv::Rect Drawable::getBounds() const {
+
+    return { 0, 0, m_geometrySize.width, m_geometrySize.height };
+
+}
+
 cv::Scalar Drawable::getColor() const {
 
     return m_color;
 
 }
 
+const std::shared_ptr<Homography>& Drawable::getHomography() const {
+
+    return m_homography;
+
+}
+
 int Drawable::getThickness() const {
 
     return m_thickness;
 
 }
 
+const char* Drawable::getTypeName() const {
+
+    return "Drawable";
+
+}
+
+std::uint64_t Drawable::getVersion() const {
+
+    return m_version;
+
+}
+
+void Drawable::prepare(const cv::Size& size) {
+
+    std::uint64_t homographyVersion = m_homography ? m_homography->getVersion() : 0;
+
+    if (m_geometryVersion == m_version && m_geometryHomographyVersion == homographyVersion && m_geometrySize == size)
+        return;
+
+    updateGeometry(size);
+
+    m_geometryVersion = m_version;
+    m_geometryHomographyVersion = homographyVersion;
+    m_geometrySize = size;
+
+}
+
 void Drawable::setAlpha(float alpha) {
 
     m_alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+    invalidate();
 
 }
 
 void Drawable::setColor(cv::Scalar color) {
 
     m_color = color;
+    invalidate();
 
 }
 
 void Drawable::setThickness(int thickness) {
 
     m_thickness = thickness;
+    invalidate();
+
+}
+
+void Drawable::updateGeometry(const cv::Size&) {
+
+}
+
+void Drawable::invalidate() {
+
+    m_version = nextVersion();
+
+}
+
+cv::Rect Drawable::computeBounds(const std::vector<cv::Point>& points, int thickness) {
+
+    if (points.empty())
+        return {};
+
+    // Half of the line width plus pixels touched by antialiasing.
+    int padding = std::max(thickness, 1) / 2 + 2;
+
+    cv::Rect bounds = cv::boundingRect(points);
+
+    return { bounds.x - padding, bounds.y - padding, bounds.width + 2 * padding, bounds.height + 2 * padding };
+
+}
+
+std::uint64_t Drawable::nextVersion() {
+
+    // Versions are unique across all drawables, so a drawable is never
+    // mistaken for another one that was destroyed before it was created.
+    static std::atomic<std::uint64_t> version { 1 };
+
+    return version++;
 
 }
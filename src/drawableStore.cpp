@@ -0,0 +1,228 @@
+
+#include "drawableStore.hpp"
+
+#include <algorithm>
+
+DrawableHandle DrawableStore::insert(std::unique_ptr<Drawable> drawable) {
+
+    if (!drawable)
+        return {};
+
+    std::uint32_t index;
+
+    if (m_freeSlots.empty()) {
+        index = static_cast<std::uint32_t>(m_slots.size());
+        m_slots.emplace_back();
+    } else {
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+
+    Slot& slot = m_slots[index];
+
+    slot.position = static_cast<std::uint32_t>(m_drawables.size());
+    slot.order = m_nextOrder++;
+
+    const DrawableHandle handle { index, slot.generation };
+
+    m_lookup.emplace(drawable.get(), handle);
+    m_drawables.push_back(std::move(drawable));
+    m_handles.push_back(handle);
+
+    return handle;
+
+}
+
+std::unique_ptr<Drawable> DrawableStore::remove(DrawableHandle handle) {
+
+    if (!findSlot(handle))
+        return nullptr;
+
+    Slot& slot = m_slots[handle.index];
+
+    // Entry stays in draw order until the next compaction, so positions of other drawables do not change.
+    std::unique_ptr<Drawable> drawable = std::move(m_drawables[slot.position]);
+
+    m_handles[slot.position] = {};
+    m_lookup.erase(drawable.get());
+    m_removedCount++;
+
+    // Generation 0 is reserved for null handles.
+    if (++slot.generation == 0)
+        slot.generation = 1;
+
+    m_freeSlots.push_back(handle.index);
+
+    return drawable;
+
+}
+
+void DrawableStore::clear() {
+
+    for (std::size_t i = 0; i < m_handles.size(); i++)
+        if (!m_handles[i].isNull())
+            remove(m_handles[i]);
+
+    m_drawables.clear();
+    m_handles.clear();
+
+    m_removedCount = 0;
+    m_sorted = true;
+
+}
+
+Drawable* DrawableStore::get(DrawableHandle handle) const {
+
+    const Slot* slot = findSlot(handle);
+
+    return slot ? m_drawables[slot->position].get() : nullptr;
+
+}
+
+DrawableHandle DrawableStore::find(const Drawable* drawable) const {
+
+    auto iterator = m_lookup.find(drawable);
+
+    return iterator != m_lookup.end() ? iterator->second : DrawableHandle {};
+
+}
+
+bool DrawableStore::contains(DrawableHandle handle) const {
+
+    return findSlot(handle) != nullptr;
+
+}
+
+std::int64_t DrawableStore::getOrder(DrawableHandle handle) const {
+
+    const Slot* slot = findSlot(handle);
+
+    return slot ? slot->order : 0;
+
+}
+
+bool DrawableStore::setOrder(DrawableHandle handle, std::int64_t order) {
+
+    if (!findSlot(handle))
+        return false;
+
+    Slot& slot = m_slots[handle.index];
+
+    if (slot.order != order) {
+        slot.order = order;
+        m_sorted = false;
+    }
+
+    // Drawables inserted later are still drawn last.
+    m_nextOrder = std::max(m_nextOrder, order + 1);
+
+    return true;
+
+}
+
+void DrawableStore::compact() {
+
+    if (m_removedCount == 0 && m_sorted)
+        return;
+
+    std::vector<std::size_t> positions;
+
+    positions.reserve(m_drawables.size() - m_removedCount);
+
+    for (std::size_t i = 0; i < m_handles.size(); i++)
+        if (!m_handles[i].isNull())
+            positions.push_back(i);
+
+    if (!m_sorted) {
+
+        std::stable_sort(positions.begin(), positions.end(), [this](std::size_t first, std::size_t second) {
+
+            return m_slots[m_handles[first].index].order < m_slots[m_handles[second].index].order;
+
+        });
+
+    }
+
+    std::vector<std::unique_ptr<Drawable>> drawables;
+    std::vector<DrawableHandle> handles;
+
+    drawables.reserve(positions.size());
+    handles.reserve(positions.size());
+
+    for (std::size_t position : positions) {
+
+        m_slots[m_handles[position].index].position = static_cast<std::uint32_t>(drawables.size());
+
+        drawables.push_back(std::move(m_drawables[position]));
+        handles.push_back(m_handles[position]);
+
+    }
+
+    m_drawables = std::move(drawables);
+    m_handles = std::move(handles);
+
+    m_removedCount = 0;
+    m_sorted = true;
+
+}
+
+const std::vector<std::unique_ptr<Drawable>>& DrawableStore::getDrawables() {
+
+    compact();
+
+    return m_drawables;
+
+}
+
+DrawableHandle DrawableStore::getHandle(std::size_t position) const {
+
+    return m_handles[position];
+
+}
+
+std::size_t DrawableStore::getSlotCount() const {
+
+    return m_slots.size();
+
+}
+
+std::size_t DrawableStore::size() const {
+
+    return m_drawables.size();
+
+}
+
+bool DrawableStore::empty() const {
+
+    return m_drawables.empty();
+
+}
+
+const std::unique_ptr<Drawable>& DrawableStore::operator[](std::size_t position) const {
+
+    return m_drawables[position];
+
+}
+
+std::vector<std::unique_ptr<Drawable>>::const_iterator DrawableStore::begin() const {
+
+    return m_drawables.begin();
+
+}
+
+std::vector<std::unique_ptr<Drawable>>::const_iterator DrawableStore::end() const {
+
+    return m_drawables.end();
+
+}
+
+const DrawableStore::Slot* DrawableStore::findSlot(DrawableHandle handle) const {
+
+    if (handle.isNull() || handle.index >= m_slots.size())
+        return nullptr;
+
+    const Slot& slot = m_slots[handle.index];
+
+    return slot.generation == handle.generation ? &slot : nullptr;
+
+}
@@ -4,6 +4,37 @@
 #include "context.hpp"
 #include "homography.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Maximum length of a single contour segment in image pixels.
+constexpr float maxSegmentLength = 2.0f;
+
+// Number of samples used to estimate the perimeter of the transformed circle.
+constexpr int perimeterSamples = 16;
+
+// Maximum number of contour points of a single circle.
+constexpr int maxSamples = 2048;
+
+void sampleCircle(const cv::Point2f& center, float radius, int count, std::vector<cv::Point2f>& points) {
+
+    points.resize(count);
+
+    for (int i = 0; i < count; i++) {
+
+        float angle = static_cast<float>(2.0 * CV_PI * i / count);
+
+        points[i] = { center.x + radius * std::cos(angle), center.y + radius * std::sin(angle) };
+
+    }
+
+}
+
+}
+
 Circle::Circle(std::shared_ptr<Homography> homography)
     : Drawable { std::move(homography) }
 {
@@ -11,12 +42,34 @@ Circle::Circle(std::shared_ptr<Homography> homography)
 
 void Circle::draw(Context& context) {
 
-    updatePoints(context.getSize());
+    prepare(context.getSize());
 
     if (m_points.empty())
         return;
 
-    cv::drawContours(context.getImage(), m_points, 0, { m_color[0], m_color[1], m_color[2], 255.0 * m_alpha }, m_thickness, cv::LINE_AA);
+    cv::drawContours(context.getClippedImage(), m_points, 0, context.getColor(m_color, m_alpha), m_thickness, cv::LINE_AA
+                   , cv::noArray(), std::numeric_limits<int>::max(), -context.getClip().tl());
+
+}
+
+cv::Rect Circle::getBounds() const {
+
+    if (m_points.empty())
+        return {};
+
+    return computeBounds(m_points[0], m_thickness);
+
+}
+
+const char* Circle::getTypeName() const {
+
+    return "Circle";
+
+}
+
+Circle::Mode Circle::getMode() const {
+
+    return m_mode;
 
 }
 
@@ -32,15 +85,24 @@ int Circle::getRadius() const {
 
 }
 
+void Circle::setMode(Mode mode) {
+
+    m_mode = mode;
+    invalidate();
+
+}
+
 void Circle::setPoint(cv::Point2f point) {
 
     m_point = std::move(point);
+    invalidate();
 
 }
 
 void Circle::setRadius(int radius) {
 
     m_radius = radius;
+    invalidate();
 
 }
 
@@ -55,11 +117,68 @@ std::unique_ptr<Circle> Circle::create(std::shared_ptr<Homography> homography, c
 
 }
 
+void Circle::updateGeometry(const cv::Size& size) {
+
+    updatePoints(size);
+
+}
+
 void Circle::updatePoints(const cv::Size& size) {
 
+    if (m_mode == Mode::Raster)
+        updatePointsRaster(size);
+    else
+        updatePointsAnalytic();
+
+}
+
+void Circle::updatePointsAnalytic() {
+
+    m_points.clear();
+
+    if (m_radius <= 0)
+        return;
+
+    cv::Point2f center;
+
+    m_homography->project(&m_point, &center, 1);
+
+    // Estimate the perimeter of the circle in image, so the number
+    // of samples adapts to the size of the circle after the transformation.
+    std::vector<cv::Point2f> samples;
+
+    sampleCircle(center, static_cast<float>(m_radius), perimeterSamples, samples);
+
+    m_homography->unproject(samples, samples);
+
+    double perimeter = 0.0;
+
+    for (int i = 0; i < perimeterSamples; i++)
+        perimeter += cv::norm(samples[(i + 1) % perimeterSamples] - samples[i]);
+
+    int count = std::clamp(static_cast<int>(std::ceil(perimeter / maxSegmentLength)), perimeterSamples, maxSamples);
+
+    sampleCircle(center, static_cast<float>(m_radius), count, samples);
+
+    m_homography->unproject(samples, samples);
+
+    m_points = {{}};
+
+    m_points[0].reserve(samples.size());
+
+    for (const cv::Point2f& sample : samples) {
+
+        m_points[0].push_back({ static_cast<int>(std::round(sample.x)), static_cast<int>(std::round(sample.y)) });
+
+    }
+
+}
+
+void Circle::updatePointsRaster(const cv::Size& size) {
+
     std::vector<cv::Point2f> points { m_point };
 
-    cv::perspectiveTransform(points, points, m_homography->getHomographyMatrix());
+    m_homography->project(points, points);
 
     cv::Mat temp(size.height, size.width, CV_8UC3, { 0, 0, 0 });
 
@@ -78,7 +197,10 @@ void Circle::updatePoints(const cv::Size& size) {
     }
     catch (...) {
     }
-    
+
+    if (m_points.empty())
+        return;
+
     std::vector<cv::Point2f> tempPoints;
 
     for(uint i = 0; i < m_points[0].size(); i++){
@@ -87,7 +209,7 @@ void Circle::updatePoints(const cv::Size& size) {
 
     }
 
-    cv::perspectiveTransform(tempPoints, tempPoints, m_homography->getInverseHomographyMatrix());
+    m_homography->unproject(tempPoints, tempPoints);
 
     m_points.clear();
 
@@ -4,139 +4,133 @@
 #include "context.hpp"
 #include "homography.hpp"
 
-Image::Image(std::shared_ptr<Homography> homography)
-    : Drawable { std::move(homography) }
-{
-}
+namespace {
 
-void Image::draw(Context& context) {
+// Radius of the blur applied to the mask of image with alpha channel.
+constexpr int maskBlurRadius = 12;
 
-    cv::Mat rotatedImage = m_image.clone();
+// Multiplies color channels of BGRA image by its alpha channel.
+void premultiplyAlpha(cv::Mat image) {
 
-    switch (m_rotation) {
+    for (int y = 0; y < image.rows; y++) {
 
-        case Rotation::_90:
+        cv::Vec4b* row = image.ptr<cv::Vec4b>(y);
 
-            cv::rotate(rotatedImage, rotatedImage, cv::ROTATE_90_CLOCKWISE);
-            break;
+        for (int x = 0; x < image.cols; x++) {
 
-        case Rotation::_180:
+            const int alpha = row[x][3];
 
-            cv::rotate(rotatedImage, rotatedImage, cv::ROTATE_180);
-            break;
+            if (alpha == 255)
+                continue;
 
-        case Rotation::_270:
+            for (int i = 0; i < 3; i++)
+                row[x][i] = static_cast<uchar>((row[x][i] * alpha + 127) / 255);
 
-            cv::rotate(rotatedImage, rotatedImage, cv::ROTATE_90_COUNTERCLOCKWISE);
-            break;
-
-        default:
-
-            break;
+        }
 
     }
 
-    cv::Mat mask(context.getSize(), CV_8UC1, cv::Scalar(0));
-
-    std::vector<cv::Point2f> transformedPoints { m_from, m_to };
-
-    cv::perspectiveTransform(transformedPoints, transformedPoints, m_homography->getHomographyMatrix());
+}
 
-    std::vector<cv::Point2f> imageHomographyPoints {
+}
 
-        { transformedPoints[0].x, transformedPoints[0].y },
-        { transformedPoints[1].x, transformedPoints[0].y },
-        { transformedPoints[1].x, transformedPoints[1].y },
-        { transformedPoints[0].x, transformedPoints[1].y }
+Image::Image(std::shared_ptr<Homography> homography)
+    : Drawable { std::move(homography) }
+{
+}
 
-    };
+void Image::draw(Context& context) {
 
-    cv::Size size(static_cast<int>(std::ceil(std::abs(transformedPoints[1].x - transformedPoints[0].x)))
-                , static_cast<int>(std::ceil(std::abs(transformedPoints[1].y - transformedPoints[0].y))));
+    prepare(context.getSize());
 
-    cv::resize(rotatedImage, rotatedImage, size);
+    if (m_preparedImage.empty())
+        return;
 
-    if(transformedPoints[1].x > transformedPoints[0].x){
+    // Only the part of the object, that is inside the clip region, is warped and composited.
+    const cv::Rect frame(0, 0, context.getSize().width, context.getSize().height);
+    const cv::Rect region = getBounds() & context.getClip();
 
-        if(transformedPoints[0].y > transformedPoints[1].y){
+    if (region.empty())
+        return;
 
-            cv::rotate(rotatedImage, rotatedImage, cv::ROTATE_90_COUNTERCLOCKWISE);
+    cv::Mat mask;
 
-        }
+    if (m_hasAlpha){
+        // Picture with alpha channel, the mask is warped with a border
+        // large enough for the blur to produce the same result as
+        // if it was computed over the whole context.
+        cv::Rect maskRegion = cv::Rect(region.x - maskBlurRadius, region.y - maskBlurRadius
+                                     , region.width + 2 * maskBlurRadius, region.height + 2 * maskBlurRadius) & frame;
 
-    }else{
+        cv::warpPerspective(m_preparedAlpha, mask, computeWarpMatrix(maskRegion.tl()), maskRegion.size());
 
-        if(transformedPoints[0].y > transformedPoints[1].y){
+        cv::GaussianBlur(mask, mask, { 2 * maskBlurRadius + 1, 2 * maskBlurRadius + 1 }, 0.0);
 
-            cv::rotate(rotatedImage, rotatedImage, cv::ROTATE_180);
+        cv::threshold(mask, mask, 128.0, 255.0, cv::THRESH_BINARY);
 
-        }else{
+        mask = mask(region - maskRegion.tl());
 
-            cv::rotate(rotatedImage, rotatedImage, cv::ROTATE_90_CLOCKWISE);
+    }else {
+        // Picture without alpha channel
+        std::vector<cv::Point> polygon;
 
+        for (const cv::Point& point : m_points[0]) {
+            polygon.push_back(point - region.tl());
         }
 
-    }
-
-    cv::Point position = {static_cast<int>(std::min(transformedPoints[0].x,transformedPoints[1].x)),static_cast<int>(std::min(transformedPoints[0].y,transformedPoints[1].y))};
-
-
-
-    if (rotatedImage.channels() == 4){
-        // Picture with alpha channel
-        cv::Mat channels[4];
-
-        cv::split(rotatedImage, channels);
+        mask = cv::Mat(region.size(), CV_8UC1, cv::Scalar(0));
 
-        cv::Mat imageShape;
+        cv::fillConvexPoly(mask, polygon, { 255.0, 255.0, 255.0 });
+    }
 
-        std::vector<cv::Mat> alphaChannel;
+    cv::Mat warpedImage;
 
-        alphaChannel.push_back(channels[3]);
+    cv::warpPerspective(m_preparedImage, warpedImage, computeWarpMatrix(region.tl()), region.size());
 
-        cv::merge(alphaChannel, imageShape);
+    if (context.isPremultiplied())
+        premultiplyAlpha(warpedImage);
 
-        imageShape.copyTo(mask({ position.x, position.y, rotatedImage.cols, rotatedImage.rows }));
+    // Composite in place inside the region.
+    cv::Mat target = context.getClippedImage()(region - context.getClip().tl());
 
-        cv::warpPerspective(mask, mask, m_homography->getInverseHomographyMatrix(), context.getSize());
+    if (m_alpha >= 1.0f) {
 
-        cv::GaussianBlur(mask, mask, { 25, 25 }, 0.0);
+        warpedImage.copyTo(target, mask);
 
-        cv::threshold(mask, mask, 128.0, 255.0, cv::THRESH_BINARY);
+    } else {
 
-    }else {
-        // Picture without alpha channel
-        cv::perspectiveTransform(imageHomographyPoints, imageHomographyPoints, m_homography->getInverseHomographyMatrix());
+        cv::addWeighted(warpedImage, m_alpha, target, 1.0 - m_alpha, 0.0, warpedImage);
 
-        std::vector<cv::Point> tempWarpedPoints {
+        warpedImage.copyTo(target, mask);
 
-            { static_cast<int>(std::ceil(imageHomographyPoints[0].x)), static_cast<int>(std::ceil(imageHomographyPoints[0].y)) },
-            { static_cast<int>(std::ceil(imageHomographyPoints[1].x)), static_cast<int>(std::ceil(imageHomographyPoints[1].y)) },
-            { static_cast<int>(std::ceil(imageHomographyPoints[2].x)), static_cast<int>(std::ceil(imageHomographyPoints[2].y)) },
-            { static_cast<int>(std::ceil(imageHomographyPoints[3].x)), static_cast<int>(std::ceil(imageHomographyPoints[3].y)) }
+    }
 
-        };
+}
 
-        cv::fillConvexPoly(mask, tempWarpedPoints, { 255.0, 255.0, 255.0 });
-    }
+cv::Rect Image::getBounds() const {
 
-    if(rotatedImage.channels() == 3){
+    if (m_preparedImage.empty() || m_points.empty())
+        return {};
 
-        rotatedImage = convertBGRtoBGRA(rotatedImage).clone();
+    // Mask of image with alpha channel is blurred, which can extend it beyond the warped corners.
+    return computeBounds(m_points[0], m_hasAlpha ? 2 * maskBlurRadius + 2 : 1);
 
-    }
+}
 
-    cv::Mat warpedImage(context.getSize(), rotatedImage.type(), { 0, 0, 0, 0 });
+const char* Image::getTypeName() const {
 
-    rotatedImage.copyTo(warpedImage({ position.x, position.y, rotatedImage.cols, rotatedImage.rows }));
+    return "Image";
 
-    cv::warpPerspective(warpedImage, warpedImage, m_homography->getInverseHomographyMatrix(), context.getSize());
+}
 
-    cv::Mat background = context.getImage().clone();
+cv::Matx33d Image::computeWarpMatrix(const cv::Point& origin) const {
 
-    warpedImage.copyTo(background,mask);
+    // Moves pixel of the prepared image into the mapping plane, transforms
+    // it into the context and moves it into the region starting at origin.
+    const cv::Matx33d toMappingPlane(1.0, 0.0, m_position.x, 0.0, 1.0, m_position.y, 0.0, 0.0, 1.0);
+    const cv::Matx33d toRegion(1.0, 0.0, -origin.x, 0.0, 1.0, -origin.y, 0.0, 0.0, 1.0);
 
-    cv::addWeighted(background, m_alpha, context.getImage(), 1.0 - m_alpha, 0.0, context.getImage());
+    return toRegion * m_homography->getInverseMatrix() * toMappingPlane;
 
 }
 
@@ -167,24 +161,28 @@ const cv::Point2f& Image::getTo() const {
 void Image::setFrom(cv::Point2f from) {
 
     m_from = std::move(from);
+    invalidate();
 
 }
 
 void Image::setImage(cv::Mat image) {
 
-    m_image = image.clone();
+    m_image = image;
+    invalidate();
 
 }
 
 void Image::setRotation(Rotation rotation) {
 
     m_rotation = rotation;
+    invalidate();
 
 }
 
 void Image::setTo(cv::Point2f to) {
 
     m_to = std::move(to);
+    invalidate();
 
 }
 
@@ -200,3 +198,116 @@ std::unique_ptr<Image> Image::create(std::shared_ptr<Homography> homography, cv:
     return image;
 
 }
+
+void Image::updateGeometry(const cv::Size&) {
+
+    m_preparedImage.release();
+    m_preparedAlpha.release();
+    m_points.clear();
+
+    if (m_image.empty())
+        return;
+
+    // Source image is shared with the caller, so it is never modified in place.
+    cv::Mat rotatedImage = m_image;
+
+    switch (m_rotation) {
+
+        case Rotation::_90:
+
+            cv::rotate(m_image, rotatedImage, cv::ROTATE_90_CLOCKWISE);
+            break;
+
+        case Rotation::_180:
+
+            cv::rotate(m_image, rotatedImage, cv::ROTATE_180);
+            break;
+
+        case Rotation::_270:
+
+            cv::rotate(m_image, rotatedImage, cv::ROTATE_90_COUNTERCLOCKWISE);
+            break;
+
+        default:
+
+            break;
+
+    }
+
+    std::vector<cv::Point2f> transformedPoints { m_from, m_to };
+
+    m_homography->project(transformedPoints, transformedPoints);
+
+    std::vector<cv::Point2f> imageHomographyPoints {
+
+        { transformedPoints[0].x, transformedPoints[0].y },
+        { transformedPoints[1].x, transformedPoints[0].y },
+        { transformedPoints[1].x, transformedPoints[1].y },
+        { transformedPoints[0].x, transformedPoints[1].y }
+
+    };
+
+    cv::Size size(static_cast<int>(std::ceil(std::abs(transformedPoints[1].x - transformedPoints[0].x)))
+                , static_cast<int>(std::ceil(std::abs(transformedPoints[1].y - transformedPoints[0].y))));
+
+    if (size.width <= 0 || size.height <= 0)
+        return;
+
+    cv::Mat resizedImage;
+
+    cv::resize(rotatedImage, resizedImage, size);
+
+    rotatedImage = resizedImage;
+
+    if(transformedPoints[1].x > transformedPoints[0].x){
+
+        if(transformedPoints[0].y > transformedPoints[1].y){
+
+            cv::rotate(rotatedImage, rotatedImage, cv::ROTATE_90_COUNTERCLOCKWISE);
+
+        }
+
+    }else{
+
+        if(transformedPoints[0].y > transformedPoints[1].y){
+
+            cv::rotate(rotatedImage, rotatedImage, cv::ROTATE_180);
+
+        }else{
+
+            cv::rotate(rotatedImage, rotatedImage, cv::ROTATE_90_CLOCKWISE);
+
+        }
+
+    }
+
+    m_position = {static_cast<int>(std::min(transformedPoints[0].x,transformedPoints[1].x)),static_cast<int>(std::min(transformedPoints[0].y,transformedPoints[1].y))};
+
+    m_homography->unproject(imageHomographyPoints, imageHomographyPoints);
+
+    std::vector<cv::Point> tempWarpedPoints {
+
+        { static_cast<int>(std::ceil(imageHomographyPoints[0].x)), static_cast<int>(std::ceil(imageHomographyPoints[0].y)) },
+        { static_cast<int>(std::ceil(imageHomographyPoints[1].x)), static_cast<int>(std::ceil(imageHomographyPoints[1].y)) },
+        { static_cast<int>(std::ceil(imageHomographyPoints[2].x)), static_cast<int>(std::ceil(imageHomographyPoints[2].y)) },
+        { static_cast<int>(std::ceil(imageHomographyPoints[3].x)), static_cast<int>(std::ceil(imageHomographyPoints[3].y)) }
+
+    };
+
+    m_points = { tempWarpedPoints };
+
+    m_hasAlpha = rotatedImage.channels() == 4;
+
+    if (m_hasAlpha) {
+
+        cv::extractChannel(rotatedImage, m_preparedAlpha, 3);
+
+    } else {
+
+        rotatedImage = convertBGRtoBGRA(rotatedImage);
+
+    }
+
+    m_preparedImage = rotatedImage;
+
+}
@@ -17,13 +17,29 @@ Line::Line(std::shared_ptr<Homography> homography, Type type, cv::Size windowSiz
 
 void Line::draw(Context& context) {
 
-    m_contextSize = context.getSize();
-    updatePoints(m_windowSize);
+    prepare(context.getSize());
 
     if (m_points.size() < 2)
         return;
 
-    cv::line(context.getImage(), m_points[0], m_points[1], { m_color[0], m_color[1], m_color[2], 255.0 * m_alpha }, m_thickness, cv::LINE_AA);
+    cv::Point2f offset = context.getClip().tl();
+
+    cv::line(context.getClippedImage(), m_points[0] - offset, m_points[1] - offset, context.getColor(m_color, m_alpha), m_thickness, cv::LINE_AA);
+
+}
+
+cv::Rect Line::getBounds() const {
+
+    if (m_points.size() < 2)
+        return {};
+
+    return computeBounds({ m_points[0], m_points[1] }, m_thickness);
+
+}
+
+const char* Line::getTypeName() const {
+
+    return "Line";
 
 }
 
@@ -48,18 +64,21 @@ Line::Type Line::getType() const {
 void Line::setOffset(float offset) {
 
     m_offset = offset;
+    invalidate();
 
 }
 
 void Line::setPoint(cv::Point2f point) {
 
     m_point = std::move(point);
+    invalidate();
 
 }
 
 void Line::setType(Type type) {
 
     m_type = type;
+    invalidate();
 
 }
 
@@ -74,11 +93,18 @@ std::unique_ptr<Line> Line::create(std::shared_ptr<Homography> homography, Type
 
 }
 
+void Line::updateGeometry(const cv::Size& size) {
+
+    m_contextSize = size;
+    updatePoints(m_windowSize);
+
+}
+
 void Line::updatePoints(const cv::Size& size) {
 
     std::vector<cv::Point2f> points { m_point, m_point };
 
-    cv::perspectiveTransform(points, points, m_homography->getHomographyMatrix());
+    m_homography->project(points, points);
 
     switch (m_type) {
 
@@ -100,7 +126,7 @@ void Line::updatePoints(const cv::Size& size) {
 
     }
 
-    cv::perspectiveTransform(points, points, m_homography->getInverseHomographyMatrix());
+    m_homography->unproject(points, points);
 
     if(m_type == Type::Horizontal){
 
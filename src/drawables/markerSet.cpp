@@ -0,0 +1,366 @@
+
+#include "drawables/markerSet.hpp"
+
+#include "context.hpp"
+#include "homography.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+
+namespace {
+
+// Maximum length of a single contour segment in image pixels.
+constexpr float maxSegmentLength = 2.0f;
+
+// Minimum and maximum number of contour points of a single marker.
+constexpr int minSamples = 8;
+constexpr int maxSamples = 256;
+
+}
+
+MarkerSet::MarkerSet(std::shared_ptr<Homography> homography)
+    : Drawable { std::move(homography) }
+{
+}
+
+void MarkerSet::draw(Context& context) {
+
+    prepare(context.getSize());
+
+    if (m_groups.empty())
+        return;
+
+    const cv::Rect& clip = context.getClip();
+    const cv::Point offset = -clip.tl();
+
+    cv::Mat image = context.getClippedImage();
+
+    std::vector<cv::Point> points;
+    std::vector<const cv::Point*> contours;
+    std::vector<int> sizes;
+
+    for (const Group& group : m_groups) {
+
+        points.clear();
+        sizes.clear();
+
+        // Only markers touching the clip are rasterized, so tiles do not draw the whole set.
+        for (std::size_t k = group.begin; k < group.end; k++) {
+
+            const std::size_t marker = m_order[k];
+
+            if ((m_markerBounds[marker] & clip).empty())
+                continue;
+
+            for (std::size_t i = m_offsets[marker]; i < m_offsets[marker + 1]; i++)
+                points.push_back(m_points[i] + offset);
+
+            sizes.push_back(static_cast<int>(m_offsets[marker + 1] - m_offsets[marker]));
+
+        }
+
+        if (sizes.empty())
+            continue;
+
+        contours.resize(sizes.size());
+
+        const cv::Point* contour = points.data();
+
+        for (std::size_t i = 0; i < sizes.size(); i++) {
+            contours[i] = contour;
+            contour += sizes[i];
+        }
+
+        const cv::Scalar color = context.getColor(group.color, group.alpha);
+
+        if (m_thickness < 0) {
+
+            // Filled polygons of one call would cancel out where markers overlap.
+            for (std::size_t i = 0; i < sizes.size(); i++)
+                cv::fillConvexPoly(image, contours[i], sizes[i], color, cv::LINE_AA);
+
+        } else {
+
+            cv::polylines(image, contours.data(), sizes.data(), static_cast<int>(sizes.size()), true, color, m_thickness, cv::LINE_AA);
+
+        }
+
+    }
+
+}
+
+cv::Rect MarkerSet::getBounds() const {
+
+    return m_bounds;
+
+}
+
+const char* MarkerSet::getTypeName() const {
+
+    return "MarkerSet";
+
+}
+
+const std::vector<float>& MarkerSet::getAlphas() const {
+
+    return m_alphas;
+
+}
+
+const std::vector<cv::Vec3b>& MarkerSet::getColors() const {
+
+    return m_colors;
+
+}
+
+std::size_t MarkerSet::getCount() const {
+
+    return m_positions.size();
+
+}
+
+const std::vector<cv::Point2f>& MarkerSet::getPositions() const {
+
+    return m_positions;
+
+}
+
+const std::vector<float>& MarkerSet::getRadii() const {
+
+    return m_radii;
+
+}
+
+float MarkerSet::getRadius() const {
+
+    return m_radius;
+
+}
+
+void MarkerSet::setAlpha(float alpha) {
+
+    Drawable::setAlpha(alpha);
+
+    std::fill(m_alphas.begin(), m_alphas.end(), m_alpha);
+
+}
+
+void MarkerSet::setAlphas(const float* alphas, std::size_t count) {
+
+    count = std::min(count, m_alphas.size());
+
+    for (std::size_t i = 0; i < count; i++)
+        m_alphas[i] = std::min(std::max(alphas[i], 0.0f), 1.0f);
+
+    invalidate();
+
+}
+
+void MarkerSet::setColor(cv::Scalar color) {
+
+    Drawable::setColor(color);
+
+    std::fill(m_colors.begin(), m_colors.end(), cv::Vec3b(cv::saturate_cast<uchar>(color[0]), cv::saturate_cast<uchar>(color[1]), cv::saturate_cast<uchar>(color[2])));
+
+}
+
+void MarkerSet::setColors(const cv::Vec3b* colors, std::size_t count) {
+
+    std::copy(colors, colors + std::min(count, m_colors.size()), m_colors.begin());
+    invalidate();
+
+}
+
+void MarkerSet::setCount(std::size_t count) {
+
+    m_positions.resize(count);
+    m_radii.resize(count, m_radius);
+    m_colors.resize(count, cv::Vec3b(cv::saturate_cast<uchar>(m_color[0]), cv::saturate_cast<uchar>(m_color[1]), cv::saturate_cast<uchar>(m_color[2])));
+    m_alphas.resize(count, m_alpha);
+    invalidate();
+
+}
+
+void MarkerSet::setPositions(const cv::Point2f* positions, std::size_t count) {
+
+    setCount(count);
+
+    std::copy(positions, positions + count, m_positions.begin());
+
+}
+
+void MarkerSet::setPositions(const std::vector<cv::Point2f>& positions) {
+
+    setPositions(positions.data(), positions.size());
+
+}
+
+void MarkerSet::setRadii(const float* radii, std::size_t count) {
+
+    std::copy(radii, radii + std::min(count, m_radii.size()), m_radii.begin());
+    invalidate();
+
+}
+
+void MarkerSet::setRadius(float radius) {
+
+    m_radius = radius;
+
+    std::fill(m_radii.begin(), m_radii.end(), m_radius);
+    invalidate();
+
+}
+
+std::unique_ptr<MarkerSet> MarkerSet::create(std::shared_ptr<Homography> homography, const std::vector<cv::Point2f>& positions, float radius) {
+
+    auto markerSet = std::make_unique<MarkerSet>(std::move(homography));
+
+    markerSet->setRadius(radius);
+    markerSet->setPositions(positions);
+
+    return markerSet;
+
+}
+
+void MarkerSet::updateGeometry(const cv::Size&) {
+
+    const std::size_t count = m_positions.size();
+
+    m_points.clear();
+    m_offsets.assign(1, 0);
+    m_markerBounds.clear();
+    m_bounds = {};
+
+    if (count == 0) {
+        m_groups.clear();
+        return;
+    }
+
+    m_homography->project(m_positions, m_centers);
+
+    // Two points on each circle estimate its radius in image, so the
+    // number of samples adapts to the size of the marker after the transformation.
+    m_samples.resize(2 * count);
+
+    for (std::size_t i = 0; i < count; i++) {
+        m_samples[2 * i] = { m_centers[i].x + m_radii[i], m_centers[i].y };
+        m_samples[2 * i + 1] = { m_centers[i].x, m_centers[i].y + m_radii[i] };
+    }
+
+    m_homography->unproject(m_samples, m_samples);
+
+    m_offsets.resize(count + 1);
+
+    for (std::size_t i = 0; i < count; i++) {
+
+        int samples = 0;
+
+        if (m_radii[i] > 0.0f) {
+
+            const double radius = std::max(cv::norm(m_samples[2 * i] - m_positions[i]), cv::norm(m_samples[2 * i + 1] - m_positions[i]));
+
+            if (std::isfinite(radius))
+                samples = std::clamp(static_cast<int>(std::ceil(2.0 * CV_PI * radius / maxSegmentLength)), minSamples, maxSamples);
+
+        }
+
+        m_offsets[i + 1] = m_offsets[i] + samples;
+
+    }
+
+    // Circles of all markers are sampled in the mapping plane and transformed into image at once.
+    m_samples.resize(m_offsets[count]);
+
+    for (std::size_t i = 0; i < count; i++) {
+
+        const std::size_t samples = m_offsets[i + 1] - m_offsets[i];
+
+        for (std::size_t j = 0; j < samples; j++) {
+
+            const float angle = static_cast<float>(2.0 * CV_PI * j / samples);
+
+            m_samples[m_offsets[i] + j] = { m_centers[i].x + m_radii[i] * std::cos(angle), m_centers[i].y + m_radii[i] * std::sin(angle) };
+
+        }
+
+    }
+
+    m_homography->unproject(m_samples, m_samples);
+
+    m_points.resize(m_samples.size());
+
+    for (std::size_t i = 0; i < m_samples.size(); i++)
+        m_points[i] = { static_cast<int>(std::round(m_samples[i].x)), static_cast<int>(std::round(m_samples[i].y)) };
+
+    // Half of the line width plus pixels touched by antialiasing.
+    const int padding = std::max(m_thickness, 1) / 2 + 2;
+
+    m_markerBounds.resize(count);
+
+    for (std::size_t i = 0; i < count; i++) {
+
+        if (m_offsets[i] == m_offsets[i + 1]) {
+            m_markerBounds[i] = {};
+            continue;
+        }
+
+        cv::Point minimum = m_points[m_offsets[i]];
+        cv::Point maximum = minimum;
+
+        for (std::size_t j = m_offsets[i] + 1; j < m_offsets[i + 1]; j++) {
+            minimum = { std::min(minimum.x, m_points[j].x), std::min(minimum.y, m_points[j].y) };
+            maximum = { std::max(maximum.x, m_points[j].x), std::max(maximum.y, m_points[j].y) };
+        }
+
+        m_markerBounds[i] = { minimum.x - padding, minimum.y - padding, maximum.x - minimum.x + 1 + 2 * padding, maximum.y - minimum.y + 1 + 2 * padding };
+
+        m_bounds = m_bounds.empty() ? m_markerBounds[i] : (m_bounds | m_markerBounds[i]);
+
+    }
+
+    updateGroups();
+
+}
+
+void MarkerSet::updateGroups() {
+
+    m_groups.clear();
+    m_order.resize(m_positions.size());
+
+    std::iota(m_order.begin(), m_order.end(), 0);
+
+    auto key = [this](std::size_t marker) {
+
+        const cv::Vec3b& color = m_colors[marker];
+
+        return std::make_tuple(color[0], color[1], color[2], m_alphas[marker]);
+
+    };
+
+    // Stable sort keeps order of overlapping markers within a group.
+    std::stable_sort(m_order.begin(), m_order.end(), [&key](std::size_t first, std::size_t second) { return key(first) < key(second); });
+
+    for (std::size_t k = 0; k < m_order.size(); k++) {
+
+        const std::size_t marker = m_order[k];
+
+        if (m_offsets[marker] == m_offsets[marker + 1])
+            continue;
+
+        if (m_groups.empty() || key(m_order[m_groups.back().begin]) != key(marker)) {
+
+            const cv::Vec3b& color = m_colors[marker];
+
+            m_groups.push_back({ cv::Scalar(color[0], color[1], color[2]), m_alphas[marker], k, k + 1 });
+
+        } else {
+
+            m_groups.back().end = k + 1;
+
+        }
+
+    }
+
+}
@@ -4,6 +4,10 @@
 #include "context.hpp"
 #include "homography.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 Rectangle::Rectangle(std::shared_ptr<Homography> homography, Type type)
     : Drawable { std::move(homography) }
     , m_type { type }
@@ -12,12 +16,28 @@ Rectangle::Rectangle(std::shared_ptr<Homography> homography, Type type)
 
 void Rectangle::draw(Context& context) {
 
-    updatePoints(context.getSize());
+    prepare(context.getSize());
 
     if (m_points.empty())
         return;
 
-    cv::drawContours(context.getImage(), m_points, 0, { m_color[0], m_color[1], m_color[2], 255.0 * m_alpha }, m_thickness, cv::LINE_AA);
+    cv::drawContours(context.getClippedImage(), m_points, 0, context.getColor(m_color, m_alpha), m_thickness, cv::LINE_AA
+                   , cv::noArray(), std::numeric_limits<int>::max(), -context.getClip().tl());
+
+}
+
+cv::Rect Rectangle::getBounds() const {
+
+    if (m_points.empty())
+        return {};
+
+    return computeBounds(m_points[0], m_thickness);
+
+}
+
+const char* Rectangle::getTypeName() const {
+
+    return "Rectangle";
 
 }
 
@@ -33,6 +53,12 @@ const cv::Point2f& Rectangle::getTo() const {
 
 }
 
+int Rectangle::getSubdivisions() const {
+
+    return m_subdivisions;
+
+}
+
 Rectangle::Type Rectangle::getType() const {
 
     return m_type;
@@ -42,18 +68,28 @@ Rectangle::Type Rectangle::getType() const {
 void Rectangle::setFrom(cv::Point2f from) {
 
     m_from = std::move(from);
+    invalidate();
+
+}
+
+void Rectangle::setSubdivisions(int subdivisions) {
+
+    m_subdivisions = std::max(subdivisions, 0);
+    invalidate();
 
 }
 
 void Rectangle::setTo(cv::Point2f to) {
 
     m_to = std::move(to);
+    invalidate();
 
 }
 
 void Rectangle::setType(Type type) {
 
     m_type = type;
+    invalidate();
 
 }
 
@@ -68,13 +104,17 @@ std::unique_ptr<Rectangle> Rectangle::create(std::shared_ptr<Homography> homogra
 
 }
 
-void Rectangle::updatePoints(const cv::Size& size) {
+void Rectangle::updateGeometry(const cv::Size& size) {
 
-    std::vector<cv::Point2f> points { m_from, m_to };
+    updatePoints(size);
 
-    cv::perspectiveTransform(points, points, m_homography->getHomographyMatrix());
+}
+
+void Rectangle::updatePoints(const cv::Size&) {
+
+    std::vector<cv::Point2f> points { m_from, m_to };
 
-    cv::Mat temp(size.height, size.width, CV_8UC3, { 0, 0, 0 });
+    m_homography->project(points, points);
 
     if(m_type == Type::Square){
 
@@ -122,37 +162,48 @@ void Rectangle::updatePoints(const cv::Size& size) {
 
     }
 
-    cv::rectangle(temp, points[0], points[1], { 0.0, 0.0, 255.0 }, 1, cv::LINE_AA);
+    // Corners of the object in the mapping plane.
+    const cv::Point2f corners[] {
 
-    cv::cvtColor(temp, temp, cv::COLOR_BGR2GRAY);
+        { points[0].x, points[0].y },
+        { points[1].x, points[0].y },
+        { points[1].x, points[1].y },
+        { points[0].x, points[1].y }
 
-    m_points.clear();
+    };
 
-    try {
+    // Each edge is split into segments, the corners are
+    // followed by evenly spaced points along the edge.
+    const int segments = m_subdivisions + 1;
 
-        cv::findContours(temp, m_points, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
+    std::vector<cv::Point2f> contour;
 
-    }
-    catch (...) {
-    }
-    
-    std::vector<cv::Point2f> tempPoints;
+    contour.reserve(4 * segments);
 
-    for(uint i = 0; i < m_points[0].size(); i++){
+    for (int i = 0; i < 4; i++) {
 
-        tempPoints.push_back(m_points[0][i]);
+        const cv::Point2f& from = corners[i];
+        const cv::Point2f& to = corners[(i + 1) % 4];
 
-    }
+        for (int j = 0; j < segments; j++) {
+
+            float t = static_cast<float>(j) / segments;
 
-    cv::perspectiveTransform(tempPoints, tempPoints, m_homography->getInverseHomographyMatrix());
+            contour.push_back(from + (to - from) * t);
 
-    m_points.clear();
+        }
+
+    }
+
+    m_homography->unproject(contour, contour);
 
     m_points = {{}};
 
-    for(uint i = 0; i < tempPoints.size(); i++){
+    m_points[0].reserve(contour.size());
+
+    for (const cv::Point2f& point : contour) {
 
-        m_points[0].push_back({static_cast<int>(std::round(tempPoints[i].x)),static_cast<int>(std::round(tempPoints[i].y))});
+        m_points[0].push_back({ static_cast<int>(std::round(point.x)), static_cast<int>(std::round(point.y)) });
 
     }
 
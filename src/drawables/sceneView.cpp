@@ -0,0 +1,149 @@
+
+#include "drawables/sceneView.hpp"
+
+#include "context.hpp"
+#include "homography.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SceneView::SceneView(std::shared_ptr<Homography> homography, std::shared_ptr<WorldScene> scene)
+    : Drawable { std::move(homography) }, m_scene { std::move(scene) }
+{
+}
+
+void SceneView::draw(Context& context) {
+
+    prepare(context.getSize());
+
+    if (m_bounds.empty())
+        return;
+
+    const cv::Rect& clip = context.getClip();
+    const cv::Point offset = -clip.tl();
+
+    cv::Mat image = context.getClippedImage();
+
+    const std::vector<WorldScene::Shape>& shapes = m_scene->getShapes();
+
+    std::vector<cv::Point> points;
+
+    for (std::size_t i = 0; i < shapes.size(); i++) {
+
+        // Only shapes touching the clip are rasterized, so tiles do not draw the whole scene.
+        if ((m_shapeBounds[i] & clip).empty())
+            continue;
+
+        const WorldScene::Shape& shape = shapes[i];
+
+        points.clear();
+
+        for (std::size_t j = shape.begin; j < shape.end; j++)
+            points.push_back(m_points[j] + offset);
+
+        const cv::Point* contour = points.data();
+        const int size = static_cast<int>(points.size());
+        const cv::Scalar color = context.getColor(shape.color, shape.alpha * m_alpha);
+
+        if (shape.thickness < 0)
+            cv::fillPoly(image, &contour, &size, 1, color, cv::LINE_AA);
+        else
+            cv::polylines(image, &contour, &size, 1, shape.closed, color, shape.thickness, cv::LINE_AA);
+
+    }
+
+}
+
+cv::Rect SceneView::getBounds() const {
+
+    return m_bounds;
+
+}
+
+const char* SceneView::getTypeName() const {
+
+    return "SceneView";
+
+}
+
+const std::shared_ptr<WorldScene>& SceneView::getScene() const {
+
+    return m_scene;
+
+}
+
+void SceneView::prepare(const cv::Size& size) {
+
+    if (m_scene && m_scene->getVersion() != m_sceneVersion) {
+        m_scene->prepare();
+        m_sceneVersion = m_scene->getVersion();
+        invalidate();
+    }
+
+    Drawable::prepare(size);
+
+}
+
+std::unique_ptr<SceneView> SceneView::create(std::shared_ptr<Homography> homography, std::shared_ptr<WorldScene> scene) {
+
+    return std::make_unique<SceneView>(std::move(homography), std::move(scene));
+
+}
+
+void SceneView::updateGeometry(const cv::Size&) {
+
+    m_points.clear();
+    m_shapeBounds.clear();
+    m_bounds = {};
+
+    if (!m_scene)
+        return;
+
+    const std::vector<WorldScene::Shape>& shapes = m_scene->getShapes();
+
+    // Points of the scene are shared by all views, only the transformation into image is done per view.
+    m_homography->unproject(m_scene->getPoints(), m_samples);
+
+    m_points.resize(m_samples.size());
+    m_shapeBounds.resize(shapes.size());
+
+    for (std::size_t i = 0; i < shapes.size(); i++) {
+
+        const WorldScene::Shape& shape = shapes[i];
+
+        m_shapeBounds[i] = {};
+
+        if (shape.begin == shape.end || shape.alpha * m_alpha <= 0.0f)
+            continue;
+
+        // Points close to the horizon of the camera can not be converted into pixels.
+        bool finite = true;
+
+        for (std::size_t j = shape.begin; j < shape.end && finite; j++)
+            finite = std::abs(m_samples[j].x) < 1e6f && std::abs(m_samples[j].y) < 1e6f;
+
+        if (!finite)
+            continue;
+
+        cv::Point minimum { static_cast<int>(std::round(m_samples[shape.begin].x)), static_cast<int>(std::round(m_samples[shape.begin].y)) };
+        cv::Point maximum = minimum;
+
+        for (std::size_t j = shape.begin; j < shape.end; j++) {
+
+            m_points[j] = { static_cast<int>(std::round(m_samples[j].x)), static_cast<int>(std::round(m_samples[j].y)) };
+
+            minimum = { std::min(minimum.x, m_points[j].x), std::min(minimum.y, m_points[j].y) };
+            maximum = { std::max(maximum.x, m_points[j].x), std::max(maximum.y, m_points[j].y) };
+
+        }
+
+        // Half of the line width plus pixels touched by antialiasing.
+        const int padding = std::max(shape.thickness, 1) / 2 + 2;
+
+        m_shapeBounds[i] = { minimum.x - padding, minimum.y - padding, maximum.x - minimum.x + 1 + 2 * padding, maximum.y - minimum.y + 1 + 2 * padding };
+
+        m_bounds = m_bounds.empty() ? m_shapeBounds[i] : (m_bounds | m_shapeBounds[i]);
+
+    }
+
+}
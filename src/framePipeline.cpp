@@ -0,0 +1,231 @@
+
+#include "framePipeline.hpp"
+
+#include <utility>
+
+FramePipeline::FramePipeline(Renderer& renderer, std::size_t queueSize)
+    : m_renderer { renderer }
+    , m_queueSize { queueSize > 0 ? queueSize : 1 }
+    , m_freeFrames { 2 * m_queueSize + 3 }
+    , m_decodedFrames { m_queueSize }
+    , m_renderedFrames { m_queueSize }
+{
+}
+
+FramePipeline::~FramePipeline() {
+
+    stop();
+
+}
+
+void FramePipeline::start(Source source, Sink sink) {
+
+    stop();
+
+    m_freeFrames.reset();
+    m_decodedFrames.reset();
+    m_renderedFrames.reset();
+
+    m_frameCount = 0;
+    m_exception = nullptr;
+    m_stopped = false;
+
+    // Each stage holds one buffer while it works on it, remaining buffers wait in queues.
+    for (std::size_t i = 0; i < 2 * m_queueSize + 3; i++) {
+        m_freeFrames.push({});
+    }
+
+    m_decodeThread = std::thread(&FramePipeline::decode, this, std::move(source));
+    m_renderThread = std::thread(&FramePipeline::render, this);
+    m_encodeThread = std::thread(&FramePipeline::encode, this, std::move(sink));
+
+}
+
+void FramePipeline::stop() {
+
+    m_stopped = true;
+
+    closeQueues();
+    join();
+
+}
+
+void FramePipeline::wait() {
+
+    join();
+
+    std::lock_guard<std::mutex> lock(m_exceptionMutex);
+
+    if (m_exception) {
+
+        std::exception_ptr exception = m_exception;
+
+        m_exception = nullptr;
+
+        std::rethrow_exception(exception);
+
+    }
+
+}
+
+std::uint64_t FramePipeline::getFrameCount() const {
+
+    return m_frameCount;
+
+}
+
+bool FramePipeline::isRunning() const {
+
+    return m_decodeThread.joinable() || m_renderThread.joinable() || m_encodeThread.joinable();
+
+}
+
+void FramePipeline::setUpdateCallback(UpdateCallback callback) {
+
+    m_updateCallback = std::move(callback);
+
+}
+
+FramePipeline::Source FramePipeline::createSource(cv::VideoCapture& capture) {
+
+    return [&capture](cv::Mat& frame) {
+
+        return capture.read(frame);
+
+    };
+
+}
+
+FramePipeline::Sink FramePipeline::createSink(cv::VideoWriter& writer) {
+
+    return [&writer](const cv::Mat& frame) {
+
+        writer.write(frame);
+
+    };
+
+}
+
+void FramePipeline::decode(Source source) {
+
+    try {
+
+        cv::Mat frame;
+
+        while (m_freeFrames.pop(frame)) {
+
+            if (m_stopped || !source(frame) || frame.empty())
+                break;
+
+            if (!m_decodedFrames.push(std::move(frame)))
+                break;
+
+        }
+
+    }
+    catch (...) {
+        fail(std::current_exception());
+    }
+
+    m_decodedFrames.close();
+
+}
+
+void FramePipeline::render() {
+
+    try {
+
+        cv::Mat frame;
+
+        std::uint64_t frameIndex = 0;
+
+        while (m_decodedFrames.pop(frame)) {
+
+            // Closed queue still returns frames decoded before, they are not rendered after stop.
+            if (m_stopped)
+                break;
+
+            if (m_updateCallback)
+                m_updateCallback(m_renderer, frameIndex);
+
+            m_renderer.renderOnto(frame);
+
+            if (!m_renderedFrames.push(std::move(frame)))
+                break;
+
+            frameIndex++;
+
+        }
+
+    }
+    catch (...) {
+        fail(std::current_exception());
+    }
+
+    m_renderedFrames.close();
+
+}
+
+void FramePipeline::encode(Sink sink) {
+
+    try {
+
+        cv::Mat frame;
+
+        while (m_renderedFrames.pop(frame)) {
+
+            if (m_stopped)
+                break;
+
+            sink(frame);
+
+            m_frameCount++;
+
+            // Frame buffer is returned to the source and reused for another frame.
+            m_freeFrames.push(std::move(frame));
+
+        }
+
+    }
+    catch (...) {
+        fail(std::current_exception());
+    }
+
+    // Stages waiting for free buffers are released once the last stage finishes.
+    closeQueues();
+
+}
+
+void FramePipeline::fail(std::exception_ptr exception) {
+
+    {
+        std::lock_guard<std::mutex> lock(m_exceptionMutex);
+
+        if (!m_exception)
+            m_exception = exception;
+    }
+
+    m_stopped = true;
+
+    closeQueues();
+
+}
+
+void FramePipeline::closeQueues() {
+
+    m_freeFrames.close();
+    m_decodedFrames.close();
+    m_renderedFrames.close();
+
+}
+
+void FramePipeline::join() {
+
+    for (std::thread* thread : { &m_decodeThread, &m_renderThread, &m_encodeThread }) {
+
+        if (thread->joinable())
+            thread->join();
+
+    }
+
+}
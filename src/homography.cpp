@@ -3,9 +3,251 @@
 
 #include "pointManager.hpp"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Maximum number of cached remap tables.
+constexpr std::size_t maxWarpMaps = 4;
+
+// Homography matrix normalized so that its last element is one.
+using Parameters = cv::Vec<double, 8>;
+
+using NormalMatrix = cv::Matx<double, 8, 8>;
+
+int getEstimationFlag(Homography::Method method) {
+
+    switch (method) {
+
+        case Homography::Method::RANSAC:
+
+            return cv::RANSAC;
+
+        case Homography::Method::USAC:
+
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 5)
+            return cv::USAC_DEFAULT;
+#else
+            return cv::RANSAC;
+#endif
+
+        default:
+
+            return 0;
+
+    }
+
+}
+
+// Returns sum of squared distances in mapping plane between transformed image points and
+// mapping points, points with zero in mask are skipped. If normal is not null, normal
+// equations of Gauss-Newton step are accumulated into normal and gradient.
+double evaluateParameters(const Parameters& h, const std::vector<cv::Point2f>& imagePoints, const std::vector<cv::Point2f>& mappingPoints,
+                          const std::vector<unsigned char>& mask, NormalMatrix* normal, Parameters* gradient) {
+
+    double error = 0.0;
+
+    if (normal) {
+        *normal = NormalMatrix::zeros();
+        *gradient = Parameters::all(0.0);
+    }
+
+    for (std::size_t i = 0; i < imagePoints.size(); i++) {
+
+        if (!mask.empty() && !mask[i])
+            continue;
+
+        const double x = imagePoints[i].x;
+        const double y = imagePoints[i].y;
+
+        const double w = h[6] * x + h[7] * y + 1.0;
+
+        if (std::abs(w) < DBL_EPSILON)
+            return std::numeric_limits<double>::infinity();
+
+        const double inverseW = 1.0 / w;
+
+        const double px = (h[0] * x + h[1] * y + h[2]) * inverseW;
+        const double py = (h[3] * x + h[4] * y + h[5]) * inverseW;
+
+        const double rx = px - mappingPoints[i].x;
+        const double ry = py - mappingPoints[i].y;
+
+        error += rx * rx + ry * ry;
+
+        if (!normal)
+            continue;
+
+        const double jx[8] { x * inverseW, y * inverseW, inverseW, 0.0, 0.0, 0.0, -x * px * inverseW, -y * px * inverseW };
+        const double jy[8] { 0.0, 0.0, 0.0, x * inverseW, y * inverseW, inverseW, -x * py * inverseW, -y * py * inverseW };
+
+        for (int a = 0; a < 8; a++) {
+
+            (*gradient)[a] += jx[a] * rx + jy[a] * ry;
+
+            for (int b = 0; b <= a; b++)
+                (*normal)(a, b) += jx[a] * jx[b] + jy[a] * jy[b];
+
+        }
+
+    }
+
+    if (normal) {
+
+        for (int a = 0; a < 8; a++)
+            for (int b = a + 1; b < 8; b++)
+                (*normal)(a, b) = (*normal)(b, a);
+
+    }
+
+    return error;
+
+}
+
+// Minimizes distances in mapping plane by Levenberg-Marquardt iterations starting at matrix.
+// Returns false if the matrix can not be normalized or if the error is not finite.
+bool refineMatrix(cv::Matx33d& matrix, const std::vector<cv::Point2f>& imagePoints, const std::vector<cv::Point2f>& mappingPoints,
+                  const std::vector<unsigned char>& mask, int iterations) {
+
+    if (std::abs(matrix(2, 2)) < DBL_EPSILON)
+        return false;
+
+    Parameters h;
+
+    for (int i = 0; i < 8; i++)
+        h[i] = matrix.val[i] / matrix(2, 2);
+
+    NormalMatrix normal;
+    Parameters gradient;
+
+    double error = evaluateParameters(h, imagePoints, mappingPoints, mask, &normal, &gradient);
+
+    if (!std::isfinite(error))
+        return false;
+
+    double lambda = 1e-3;
+
+    for (int iteration = 0; iteration < iterations && lambda < 1e8; iteration++) {
+
+        // Diagonal is scaled by damping factor, which keeps the step invariant to scale of parameters.
+        NormalMatrix damped = normal;
+
+        for (int i = 0; i < 8; i++)
+            damped(i, i) += lambda * std::max(normal(i, i), DBL_EPSILON);
+
+        Parameters step;
+
+        if (!cv::solve(damped, -gradient, step, cv::DECOMP_CHOLESKY)) {
+            lambda *= 10.0;
+            continue;
+        }
+
+        const Parameters candidate = h + step;
+
+        NormalMatrix candidateNormal;
+        Parameters candidateGradient;
+
+        const double candidateError = evaluateParameters(candidate, imagePoints, mappingPoints, mask, &candidateNormal, &candidateGradient);
+
+        if (!std::isfinite(candidateError) || candidateError >= error) {
+            lambda *= 10.0;
+            continue;
+        }
+
+        h = candidate;
+        error = candidateError;
+        normal = candidateNormal;
+        gradient = candidateGradient;
+
+        lambda = std::max(lambda * 0.1, 1e-9);
+
+        if (cv::norm(step) <= 1e-12 * (cv::norm(h) + 1e-12))
+            break;
+
+    }
+
+    matrix = cv::Matx33d(h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], 1.0);
+
+    return true;
+
+}
+
+// Transforms points in the same way as cv::perspectiveTransform, the
+// matrix is applied in double precision and points with w close to
+// zero are transformed into the origin.
+void transformPoints(const cv::Matx33d& m, const cv::Point2f* points, cv::Point2f* output, std::size_t count) {
+
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+
+    const __m128d m00 = _mm_set1_pd(m(0, 0)), m01 = _mm_set1_pd(m(0, 1)), m02 = _mm_set1_pd(m(0, 2));
+    const __m128d m10 = _mm_set1_pd(m(1, 0)), m11 = _mm_set1_pd(m(1, 1)), m12 = _mm_set1_pd(m(1, 2));
+    const __m128d m20 = _mm_set1_pd(m(2, 0)), m21 = _mm_set1_pd(m(2, 1)), m22 = _mm_set1_pd(m(2, 2));
+
+    const __m128d epsilon = _mm_set1_pd(FLT_EPSILON);
+    const __m128d signMask = _mm_set1_pd(-0.0);
+
+    // Two points are processed at once, coordinates are deinterleaved into x and y vectors.
+    for (; i + 2 <= count; i += 2) {
+
+        // Integer loads of 64 bits may alias points of any type, unlike loads through a double pointer.
+        const __m128d source = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(points + i))));
+        const __m128d next = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(points + i + 1))));
+
+        const __m128d x = _mm_unpacklo_pd(source, next);
+        const __m128d y = _mm_unpackhi_pd(source, next);
+
+        __m128d tx = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, m00), _mm_mul_pd(y, m01)), m02);
+        __m128d ty = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, m10), _mm_mul_pd(y, m11)), m12);
+        const __m128d w = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, m20), _mm_mul_pd(y, m21)), m22);
+
+        const __m128d valid = _mm_cmpgt_pd(_mm_andnot_pd(signMask, w), epsilon);
+        const __m128d scale = _mm_div_pd(_mm_set1_pd(1.0), w);
+
+        tx = _mm_and_pd(_mm_mul_pd(tx, scale), valid);
+        ty = _mm_and_pd(_mm_mul_pd(ty, scale), valid);
+
+        const __m128 result = _mm_movelh_ps(_mm_cvtpd_ps(_mm_unpacklo_pd(tx, ty)), _mm_cvtpd_ps(_mm_unpackhi_pd(tx, ty)));
+
+        _mm_storeu_ps(reinterpret_cast<float*>(output + i), result);
+
+    }
+
+#endif
+
+    for (; i < count; i++) {
+
+        const double x = points[i].x;
+        const double y = points[i].y;
+
+        double w = x * m(2, 0) + y * m(2, 1) + m(2, 2);
+
+        if (std::abs(w) > FLT_EPSILON) {
+            w = 1.0 / w;
+            output[i] = { static_cast<float>((x * m(0, 0) + y * m(0, 1) + m(0, 2)) * w), static_cast<float>((x * m(1, 0) + y * m(1, 1) + m(1, 2)) * w) };
+        } else {
+            output[i] = { 0.0f, 0.0f };
+        }
+
+    }
+
+}
+
+}
+
 Homography::Homography()
     : m_homographyMatrix { cv::Mat::eye({ 3, 3 }, CV_32F) }
     , m_inverseHomographyMatrix { m_homographyMatrix.inv() }
+    , m_matrix { cv::Matx33d::eye() }
+    , m_inverseMatrix { cv::Matx33d::eye() }
 {
 }
 
@@ -16,12 +258,67 @@ Homography::Homography(const PointManager& pointManager)
 
 void Homography::computeHomographyMatrix(const PointManager& pointManager) {
 
-    std::vector<cv::Point2f> imagePoints;
-    std::vector<cv::Point2f> mappingPoints;
+    // Arrays of user points are used directly, they are not copied.
+    const std::vector<cv::Point2f>& imagePoints = pointManager.getUserImagePoints();
+    const std::vector<cv::Point2f>& mappingPoints = pointManager.getUserMappingPoints();
+
+    cv::Mat mask;
+
+    cv::Mat matrix = cv::findHomography(imagePoints, mappingPoints, getEstimationFlag(m_method), m_reprojectionThreshold, mask);
+
+    setHomographyMatrix(matrix);
+
+    if (matrix.empty())
+        return;
+
+    if (mask.total() == imagePoints.size()) {
+        m_inlierMask.assign(mask.data, mask.data + mask.total());
+    } else {
+        m_inlierMask.assign(imagePoints.size(), 1);
+    }
 
-    pointManager.copyImageMappingPoints(imagePoints, mappingPoints);
+    m_estimated = true;
 
-    setHomographyMatrix(cv::findHomography(imagePoints, mappingPoints));
+    updateReprojectionError(imagePoints, mappingPoints);
+
+}
+
+void Homography::refineHomographyMatrix(const PointManager& pointManager, int iterations) {
+
+    const std::vector<cv::Point2f>& imagePoints = pointManager.getUserImagePoints();
+    const std::vector<cv::Point2f>& mappingPoints = pointManager.getUserMappingPoints();
+
+    const bool robust = m_method != Method::LeastSquares;
+
+    // Robust methods have to classify new user points, which requires estimation from scratch.
+    if (!m_estimated || imagePoints.size() < 4 || (robust && m_inlierMask.size() != imagePoints.size())) {
+        computeHomographyMatrix(pointManager);
+        return;
+    }
+
+    if (!robust)
+        m_inlierMask.assign(imagePoints.size(), 1);
+
+    cv::Matx33d matrix = m_matrix;
+
+    if (!refineMatrix(matrix, imagePoints, mappingPoints, m_inlierMask, iterations)) {
+        computeHomographyMatrix(pointManager);
+        return;
+    }
+
+    updateMatrices(matrix, m_homographyMatrix.type());
+
+    // Moved user points can become inliers or outliers of the refined matrix.
+    if (robust) {
+
+        project(imagePoints, m_projectedPoints);
+
+        for (std::size_t i = 0; i < imagePoints.size(); i++)
+            m_inlierMask[i] = cv::norm(m_projectedPoints[i] - mappingPoints[i]) <= m_reprojectionThreshold;
+
+    }
+
+    updateReprojectionError(imagePoints, mappingPoints);
 
 }
 
@@ -37,15 +334,257 @@ cv::Mat Homography::getInverseHomographyMatrix() const {
 
 }
 
+const cv::Matx33d& Homography::getMatrix() const {
+
+    return m_matrix;
+
+}
+
+const cv::Matx33d& Homography::getInverseMatrix() const {
+
+    return m_inverseMatrix;
+
+}
+
+std::uint64_t Homography::getVersion() const {
+
+    return m_version.value;
+
+}
+
+Homography::Method Homography::getMethod() const {
+
+    return m_method;
+
+}
+
+const std::vector<unsigned char>& Homography::getInlierMask() const {
+
+    return m_inlierMask;
+
+}
+
+double Homography::getReprojectionError() const {
+
+    return m_reprojectionError;
+
+}
+
+double Homography::getReprojectionThreshold() const {
+
+    return m_reprojectionThreshold;
+
+}
+
+void Homography::getWarpMaps(const cv::Size& size, bool inverse, cv::Mat& map1, cv::Mat& map2) const {
+
+    std::lock_guard<std::mutex> lock(m_warpMapsCache.mutex);
+
+    for (const WarpMaps& maps : m_warpMapsCache.maps) {
+
+        if (maps.size == size && maps.inverse == inverse) {
+            map1 = maps.map1;
+            map2 = maps.map2;
+            return;
+        }
+
+    }
+
+    // cv::warpPerspective maps each output pixel through the inverse of the
+    // transformation, so the forward warp samples with the inverse matrix.
+    cv::Mat transformation;
+
+    (inverse ? m_homographyMatrix : m_inverseHomographyMatrix).convertTo(transformation, CV_64F);
+
+    cv::Mat coordinates(size, CV_32FC2);
+
+    cv::parallel_for_(cv::Range(0, size.height), [&](const cv::Range& range) {
+
+        for (int y = range.start; y < range.end; y++) {
+
+            cv::Vec2f* row = coordinates.ptr<cv::Vec2f>(y);
+
+            for (int x = 0; x < size.width; x++)
+                row[x] = { static_cast<float>(x), static_cast<float>(y) };
+
+        }
+
+        cv::Mat band = coordinates.rowRange(range.start, range.end);
+
+        cv::perspectiveTransform(band, band, transformation);
+
+    });
+
+    WarpMaps maps { size, inverse, {}, {} };
+
+    cv::convertMaps(coordinates, cv::noArray(), maps.map1, maps.map2, CV_16SC2);
+
+    if (m_warpMapsCache.maps.size() >= maxWarpMaps)
+        m_warpMapsCache.maps.erase(m_warpMapsCache.maps.begin());
+
+    m_warpMapsCache.maps.push_back(maps);
+
+    map1 = maps.map1;
+    map2 = maps.map2;
+
+}
+
+void Homography::project(const cv::Point2f* points, cv::Point2f* output, std::size_t count) const {
+
+    transformPoints(m_matrix, points, output, count);
+
+}
+
+void Homography::project(const std::vector<cv::Point2f>& points, std::vector<cv::Point2f>& output) const {
+
+    output.resize(points.size());
+
+    project(points.data(), output.data(), points.size());
+
+}
+
+void Homography::unproject(const cv::Point2f* points, cv::Point2f* output, std::size_t count) const {
+
+    transformPoints(m_inverseMatrix, points, output, count);
+
+}
+
+void Homography::unproject(const std::vector<cv::Point2f>& points, std::vector<cv::Point2f>& output) const {
+
+    output.resize(points.size());
+
+    unproject(points.data(), output.data(), points.size());
+
+}
+
 void Homography::setHomographyMatrix(cv::Mat matrix) {
 
     if(matrix.empty()){
 
-        m_homographyMatrix = cv::Mat::eye({ 3, 3 }, CV_32F);
+        matrix = cv::Mat::eye({ 3, 3 }, CV_32F);
 
-    }else{
-        m_homographyMatrix = matrix.clone();
     }
-    m_inverseHomographyMatrix = m_homographyMatrix.inv();
+
+    cv::Mat matrixDouble;
+
+    matrix.convertTo(matrixDouble, CV_64F);
+
+    updateMatrices(cv::Matx33d(matrixDouble), matrix.type());
+
+    // Matrix set by user does not belong to any estimation.
+    m_estimated = false;
+    m_inlierMask.clear();
+    m_reprojectionError = 0.0;
+
+}
+
+void Homography::setMethod(Method method) {
+
+    m_method = method;
+
+}
+
+void Homography::setReprojectionThreshold(double threshold) {
+
+    m_reprojectionThreshold = threshold;
+
+}
+
+cv::Mat Homography::warpImage(cv::Mat image, const cv::Size& size, bool inverse) const {
+
+    if (image.empty() || size.empty())
+        return {};
+
+    cv::Mat map1;
+    cv::Mat map2;
+
+    getWarpMaps(size, inverse, map1, map2);
+
+    cv::Mat output;
+
+    cv::remap(image, output, map1, map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+
+    return output;
+
+}
+
+void Homography::updateMatrices(const cv::Matx33d& matrix, int type) {
+
+    m_matrix = matrix;
+    m_inverseMatrix = matrix.inv();
+
+    // New matrices are allocated, so matrices returned earlier by getHomographyMatrix are not modified.
+    cv::Mat homographyMatrix;
+    cv::Mat inverseHomographyMatrix;
+
+    cv::Mat(m_matrix).convertTo(homographyMatrix, type);
+    cv::Mat(m_inverseMatrix).convertTo(inverseHomographyMatrix, type);
+
+    m_homographyMatrix = homographyMatrix;
+    m_inverseHomographyMatrix = inverseHomographyMatrix;
+
+    m_version.value = nextVersion();
+
+    std::lock_guard<std::mutex> lock(m_warpMapsCache.mutex);
+
+    m_warpMapsCache.maps.clear();
+
+}
+
+void Homography::updateReprojectionError(const std::vector<cv::Point2f>& imagePoints, const std::vector<cv::Point2f>& mappingPoints) {
+
+    const Parameters h(m_matrix(0, 0), m_matrix(0, 1), m_matrix(0, 2), m_matrix(1, 0), m_matrix(1, 1), m_matrix(1, 2), m_matrix(2, 0), m_matrix(2, 1));
+
+    std::size_t count = 0;
+
+    for (unsigned char inlier : m_inlierMask)
+        count += inlier ? 1 : 0;
+
+    if (count == 0 || std::abs(m_matrix(2, 2)) < DBL_EPSILON) {
+        m_reprojectionError = 0.0;
+        return;
+    }
+
+    m_reprojectionError = std::sqrt(evaluateParameters(h * (1.0 / m_matrix(2, 2)), imagePoints, mappingPoints, m_inlierMask, nullptr, nullptr) / count);
+
+}
+
+Homography::WarpMapsCache& Homography::WarpMapsCache::operator=(const WarpMapsCache&) {
+
+    // Remap tables belong to the previous matrix of the assigned homography.
+    std::lock_guard<std::mutex> lock(mutex);
+
+    maps.clear();
+
+    return *this;
+
+}
+
+Homography::Version::Version()
+    : value { nextVersion() }
+{
+}
+
+Homography::Version::Version(const Version&)
+    : value { nextVersion() }
+{
+}
+
+Homography::Version& Homography::Version::operator=(const Version&) {
+
+    // Assigned homography has a new matrix, so geometry computed from the previous one is outdated.
+    value = nextVersion();
+
+    return *this;
+
+}
+
+std::uint64_t Homography::nextVersion() {
+
+    // Versions are unique across all homographies, so a homography assigned
+    // into another one never has the same version as the previous matrix.
+    static std::atomic<std::uint64_t> version { 1 };
+
+    return version++;
 
 }
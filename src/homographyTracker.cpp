@@ -0,0 +1,278 @@
+
+#include "homographyTracker.hpp"
+
+#include "homography.hpp"
+#include "pointManager.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Size of search window and number of pyramid levels of optical flow.
+const cv::Size flowWindowSize { 15, 15 };
+constexpr int flowPyramidLevels = 3;
+
+// Maximal distance between feature and the feature tracked forward and back, in downscaled pixels.
+constexpr float maxTrackingError = 1.0f;
+
+// Maximal reprojection error of features used to estimate motion, in downscaled pixels.
+constexpr double motionThreshold = 1.5;
+
+// Minimal number of features needed to estimate motion reliably.
+constexpr std::size_t minFeatureCount = 8;
+
+}
+
+HomographyTracker::HomographyTracker(std::shared_ptr<Homography> homography)
+    : m_homography { std::move(homography) }
+    , m_motion { cv::Matx33d::eye() }
+{
+}
+
+bool HomographyTracker::initialize(const cv::Mat& frame, const PointManager& pointManager) {
+
+    reset();
+
+    pointManager.copyImageMappingPoints(m_referencePoints, m_mappingPoints);
+
+    if (m_referencePoints.size() < 4 || !m_homography)
+        return false;
+
+    m_pyramidScale = m_scale;
+
+    if (!preparePyramid(frame))
+        return false;
+
+    m_homography->computeHomographyMatrix(pointManager);
+
+    m_frameSize = frame.size();
+    m_imagePoints = m_referencePoints;
+    m_motion = cv::Matx33d::eye();
+
+    detectFeatures();
+
+    std::swap(m_pyramid, m_previousPyramid);
+
+    m_tracking = m_features.size() >= minFeatureCount;
+
+    return m_tracking;
+
+}
+
+bool HomographyTracker::track(const cv::Mat& frame) {
+
+    if (!m_tracking || frame.size() != m_frameSize || !preparePyramid(frame))
+        return false;
+
+    // Features are tracked forward and back, features which do not return to their position are rejected.
+    cv::calcOpticalFlowPyrLK(m_previousPyramid, m_pyramid, m_features, m_trackedFeatures, m_status, m_errors, flowWindowSize, flowPyramidLevels);
+    cv::calcOpticalFlowPyrLK(m_pyramid, m_previousPyramid, m_trackedFeatures, m_returnedFeatures, m_returnedStatus, m_errors, flowWindowSize, flowPyramidLevels);
+
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i < m_features.size(); i++) {
+
+        if (!m_status[i] || !m_returnedStatus[i])
+            continue;
+
+        const cv::Point2f difference = m_returnedFeatures[i] - m_features[i];
+
+        if (difference.x * difference.x + difference.y * difference.y > maxTrackingError * maxTrackingError)
+            continue;
+
+        m_features[count] = m_features[i];
+        m_trackedFeatures[count] = m_trackedFeatures[i];
+        count++;
+
+    }
+
+    m_features.resize(count);
+    m_trackedFeatures.resize(count);
+
+    if (count < minFeatureCount) {
+        m_tracking = false;
+        return false;
+    }
+
+    cv::Mat inliers;
+
+    cv::Mat motion = cv::findHomography(m_features, m_trackedFeatures, cv::RANSAC, motionThreshold, inliers);
+
+    if (motion.empty() || cv::countNonZero(inliers) < static_cast<int>(minFeatureCount)) {
+        m_tracking = false;
+        return false;
+    }
+
+    // Motion is estimated in downscaled frames, it is converted into the original frame and accumulated.
+    cv::Matx33d scaledMotion;
+
+    motion.convertTo(motion, CV_64F);
+    scaledMotion = cv::Matx33d(motion);
+
+    const cv::Matx33d scale(m_pyramidScale, 0.0, 0.0, 0.0, m_pyramidScale, 0.0, 0.0, 0.0, 1.0);
+    const cv::Matx33d inverseScale(1.0 / m_pyramidScale, 0.0, 0.0, 0.0, 1.0 / m_pyramidScale, 0.0, 0.0, 0.0, 1.0);
+
+    m_motion = inverseScale * scaledMotion * scale * m_motion;
+
+    std::vector<cv::Point2f> movedPoints;
+
+    cv::perspectiveTransform(m_referencePoints, movedPoints, m_motion);
+
+    for (std::size_t i = 0; i < m_imagePoints.size(); i++)
+        m_imagePoints[i] += (movedPoints[i] - m_imagePoints[i]) * static_cast<float>(1.0 - m_smoothing);
+
+    m_homography->setHomographyMatrix(cv::findHomography(m_imagePoints, m_mappingPoints));
+
+    // Only inliers of the motion are tracked into the next frame.
+    const unsigned char* inlier = inliers.ptr<unsigned char>();
+
+    count = 0;
+
+    for (std::size_t i = 0; i < m_trackedFeatures.size(); i++) {
+
+        if (inlier[i])
+            m_features[count++] = m_trackedFeatures[i];
+
+    }
+
+    m_features.resize(count);
+
+    if (m_features.size() < static_cast<std::size_t>(m_maxFeatures) / 2)
+        detectFeatures();
+
+    std::swap(m_pyramid, m_previousPyramid);
+
+    return true;
+
+}
+
+void HomographyTracker::reset() {
+
+    m_tracking = false;
+
+    m_features.clear();
+    m_imagePoints.clear();
+
+}
+
+bool HomographyTracker::isTracking() const {
+
+    return m_tracking;
+
+}
+
+int HomographyTracker::getFeatureCount() const {
+
+    return static_cast<int>(m_features.size());
+
+}
+
+const std::vector<cv::Point2f>& HomographyTracker::getImagePoints() const {
+
+    return m_imagePoints;
+
+}
+
+int HomographyTracker::getMaxFeatures() const {
+
+    return m_maxFeatures;
+
+}
+
+double HomographyTracker::getScale() const {
+
+    return m_scale;
+
+}
+
+int HomographyTracker::getSearchRadius() const {
+
+    return m_searchRadius;
+
+}
+
+double HomographyTracker::getSmoothing() const {
+
+    return m_smoothing;
+
+}
+
+void HomographyTracker::setMaxFeatures(int maxFeatures) {
+
+    m_maxFeatures = std::max(maxFeatures, static_cast<int>(minFeatureCount));
+
+}
+
+void HomographyTracker::setScale(double scale) {
+
+    m_scale = std::min(std::max(scale, 0.05), 1.0);
+
+}
+
+void HomographyTracker::setSearchRadius(int searchRadius) {
+
+    m_searchRadius = std::max(searchRadius, 1);
+
+}
+
+void HomographyTracker::setSmoothing(double smoothing) {
+
+    m_smoothing = std::min(std::max(smoothing, 0.0), 0.95);
+
+}
+
+bool HomographyTracker::preparePyramid(const cv::Mat& frame) {
+
+    if (frame.empty())
+        return false;
+
+    switch (frame.channels()) {
+
+        case 1:
+
+            m_gray = frame;
+            break;
+
+        case 3:
+
+            cv::cvtColor(frame, m_gray, cv::COLOR_BGR2GRAY);
+            break;
+
+        case 4:
+
+            cv::cvtColor(frame, m_gray, cv::COLOR_BGRA2GRAY);
+            break;
+
+        default:
+
+            return false;
+
+    }
+
+    if (m_pyramidScale < 1.0) {
+        cv::resize(m_gray, m_scaled, cv::Size(), m_pyramidScale, m_pyramidScale, cv::INTER_AREA);
+    } else {
+        m_scaled = m_gray;
+    }
+
+    cv::buildOpticalFlowPyramid(m_scaled, m_pyramid, flowWindowSize, flowPyramidLevels);
+
+    return true;
+
+}
+
+void HomographyTracker::detectFeatures() {
+
+    // Court keypoints lie on line intersections, features are searched only around them.
+    m_mask.create(m_scaled.size(), CV_8UC1);
+    m_mask.setTo(cv::Scalar::all(0));
+
+    const int radius = std::max(static_cast<int>(std::lround(m_searchRadius * m_pyramidScale)), 1);
+
+    for (const cv::Point2f& point : m_imagePoints)
+        cv::circle(m_mask, point * static_cast<float>(m_pyramidScale), radius, cv::Scalar::all(255), cv::FILLED);
+
+    cv::goodFeaturesToTrack(m_scaled, m_features, m_maxFeatures, 0.01, 4.0, m_mask);
+
+}
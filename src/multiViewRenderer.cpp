@@ -0,0 +1,157 @@
+
+#include "multiViewRenderer.hpp"
+
+#include "drawables/sceneView.hpp"
+
+#include <algorithm>
+
+std::size_t MultiViewRenderer::addView(std::shared_ptr<Homography> homography) {
+
+    View view;
+
+    view.homography = std::move(homography);
+    view.renderer = std::make_unique<Renderer>();
+
+    for (const Layer& layer : m_layers)
+        view.renderer->addLayer(layer.name, layer.order, layer.isStatic);
+
+    for (const Scene& scene : m_scenes)
+        view.renderer->insertDrawable(SceneView::create(view.homography, scene.scene), scene.layer);
+
+    m_views.push_back(std::move(view));
+
+    return m_views.size() - 1;
+
+}
+
+bool MultiViewRenderer::addLayer(const std::string& name, int order, bool isStatic) {
+
+    auto found = std::find_if(m_layers.begin(), m_layers.end(), [&name](const Layer& layer) { return layer.name == name; });
+
+    if (found != m_layers.end() || name == Renderer::defaultLayerName)
+        return false;
+
+    Layer layer;
+
+    layer.name = name;
+    layer.order = order;
+    layer.isStatic = isStatic;
+
+    m_layers.push_back(layer);
+
+    for (View& view : m_views)
+        view.renderer->addLayer(name, order, isStatic);
+
+    return true;
+
+}
+
+void MultiViewRenderer::addScene(std::shared_ptr<WorldScene> scene, const std::string& layer) {
+
+    if (!scene)
+        return;
+
+    m_scenes.push_back({ scene, layer });
+
+    for (View& view : m_views)
+        view.renderer->insertDrawable(SceneView::create(view.homography, scene), layer);
+
+}
+
+void MultiViewRenderer::render() {
+
+    prepareScenes();
+
+    forEachView([](View& view, std::size_t) {
+
+        view.renderer->render();
+
+    });
+
+}
+
+void MultiViewRenderer::renderOnto(const std::vector<cv::Mat>& frames, Renderer::FrameFormat format) {
+
+    prepareScenes();
+
+    forEachView([&frames, format](View& view, std::size_t index) {
+
+        if (index < frames.size())
+            view.renderer->renderOnto(frames[index], format);
+
+    });
+
+}
+
+const std::shared_ptr<Homography>& MultiViewRenderer::getHomography(std::size_t view) const {
+
+    return m_views[view].homography;
+
+}
+
+bool MultiViewRenderer::getParallelViews() const {
+
+    return m_parallelViews;
+
+}
+
+Renderer& MultiViewRenderer::getRenderer(std::size_t view) {
+
+    return *m_views[view].renderer;
+
+}
+
+std::vector<std::shared_ptr<WorldScene>> MultiViewRenderer::getScenes() const {
+
+    std::vector<std::shared_ptr<WorldScene>> scenes;
+
+    scenes.reserve(m_scenes.size());
+
+    for (const Scene& scene : m_scenes)
+        scenes.push_back(scene.scene);
+
+    return scenes;
+
+}
+
+std::size_t MultiViewRenderer::getViewCount() const {
+
+    return m_views.size();
+
+}
+
+void MultiViewRenderer::setParallelViews(bool enabled) {
+
+    m_parallelViews = enabled;
+
+}
+
+void MultiViewRenderer::prepareScenes() {
+
+    // Work in mapping plane is done once here, views only transform the prepared points.
+    for (const Scene& scene : m_scenes)
+        scene.scene->prepare();
+
+}
+
+template<typename Function>
+void MultiViewRenderer::forEachView(Function function) {
+
+    if (!m_parallelViews || m_views.size() < 2) {
+
+        for (std::size_t i = 0; i < m_views.size(); i++)
+            function(m_views[i], i);
+
+        return;
+
+    }
+
+    // Parallel loops of view renderers run serially inside the tasks, so every view is drawn by one worker.
+    cv::parallel_for_(cv::Range(0, static_cast<int>(m_views.size())), [&](const cv::Range& range) {
+
+        for (int i = range.start; i < range.end; i++)
+            function(m_views[i], static_cast<std::size_t>(i));
+
+    });
+
+}
@@ -19,41 +19,55 @@ PointManager::PointManager(std::vector<cv::Point2f> mappingPoints, cv::Point2f s
 
 }
 
-PointManager::UserPoint* PointManager::addUserPoint(cv::Point2f imagePoint, cv::Point2f mappingPoint) {
+PointManager::UserPointId PointManager::addUserPoint(cv::Point2f imagePoint, cv::Point2f mappingPoint) {
 
-    m_userPoints.push_back({ std::move(imagePoint), std::move(mappingPoint) });
+    const UserPointId id = m_nextUserPointId++;
 
-    return &m_userPoints.back();
+    m_userPointIndices.emplace(id, m_userPointIds.size());
+
+    m_userImagePoints.push_back(std::move(imagePoint));
+    m_userMappingPoints.push_back(std::move(mappingPoint));
+    m_userPointIds.push_back(id);
+
+    return id;
 
 }
 
-void PointManager::removeUserPoint(UserPoint* point) {
+bool PointManager::removeUserPoint(UserPointId id) {
+
+    const int index = findUserPoint(id);
+
+    if (index < 0)
+        return false;
 
-    for (auto i = m_userPoints.begin(), end = m_userPoints.end(); i != end; ++i)
-        if (&*i == point) {
-            m_userPoints.erase(i);
-            break;
-        }
+    m_userImagePoints.erase(m_userImagePoints.begin() + index);
+    m_userMappingPoints.erase(m_userMappingPoints.begin() + index);
+    m_userPointIds.erase(m_userPointIds.begin() + index);
+    m_userPointIndices.erase(id);
+
+    // Order of user points is kept, so following points move one position back.
+    for (std::size_t i = index; i < m_userPointIds.size(); i++)
+        m_userPointIndices[m_userPointIds[i]] = i;
+
+    return true;
 
 }
 
 void PointManager::clearUserPoints() {
 
-    m_userPoints = std::list<UserPoint>();
+    m_userImagePoints.clear();
+    m_userMappingPoints.clear();
+    m_userPointIds.clear();
+    m_userPointIndices.clear();
 
 }
 
 float PointManager::computePixelDensity() {
 
-    if (m_userPoints.size() < 2)
+    if (m_userImagePoints.size() < 2)
         return {};
 
-    auto iterator = m_userPoints.begin();
-
-    const UserPoint& pointFrom = *iterator;
-    const UserPoint& pointTo = *++iterator;
-
-    double size = (cv::norm(pointTo.mappingPoint - pointFrom.mappingPoint)/m_scale.x) / cv::norm(pointTo.imagePoint - pointFrom.imagePoint);
+    double size = (cv::norm(m_userMappingPoints[1] - m_userMappingPoints[0])/m_scale.x) / cv::norm(m_userImagePoints[1] - m_userImagePoints[0]);
 
     return static_cast<float>(size);
 
@@ -61,45 +75,32 @@ float PointManager::computePixelDensity() {
 
 void PointManager::copyImageMappingPoints(std::vector<cv::Point2f>& imagePoints, std::vector<cv::Point2f>& mappingPoints) const {
 
-    imagePoints.clear();
-    imagePoints.reserve(m_userPoints.size());
+    imagePoints.assign(m_userImagePoints.begin(), m_userImagePoints.end());
+    mappingPoints.assign(m_userMappingPoints.begin(), m_userMappingPoints.end());
+
+}
 
-    mappingPoints.clear();
-    mappingPoints.reserve(m_userPoints.size());
+int PointManager::findUserPoint(UserPointId id) const {
 
-    for (const UserPoint& point : m_userPoints) {
-        imagePoints.emplace_back(point.imagePoint);
-        mappingPoints.emplace_back(point.mappingPoint);
-    }
+    auto iterator = m_userPointIndices.find(id);
+
+    return iterator != m_userPointIndices.end() ? static_cast<int>(iterator->second) : -1;
 
 }
 
 void PointManager::improvePoints(cv::Mat image, int searchWindowSize) {
 
-    if (image.empty() || m_userPoints.empty()) {
+    if (image.empty() || m_userImagePoints.empty()) {
         return;
     }
 
-    std::vector<cv::Point2f> imagePoints;
-
-    imagePoints.reserve(m_userPoints.size());
-
-    for (const UserPoint& point : m_userPoints) {
-        imagePoints.emplace_back(point.imagePoint);
-    }
-
     cv::Mat gray;
 
     cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
-    cv::cornerSubPix(gray, imagePoints, { searchWindowSize, searchWindowSize }
-                   , { -1, -1 }, { cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, 30, 0.001 });
-
-    int i = 0;
 
-    for (auto iterator = m_userPoints.begin(), end = m_userPoints.end(); iterator != end; ++iterator) {
-        iterator->imagePoint = imagePoints[i];
-        i++;
-    }
+    // Image points are contiguous, so they are refined in place.
+    cv::cornerSubPix(gray, m_userImagePoints, { searchWindowSize, searchWindowSize }
+                   , { -1, -1 }, { cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, 30, 0.001 });
 
 }
 
@@ -121,9 +122,40 @@ const cv::Point2f& PointManager::getScale() const {
 
 }
 
-const std::list<PointManager::UserPoint>& PointManager::getUserPoints() const {
+const std::vector<cv::Point2f>& PointManager::getUserImagePoints() const {
 
-    return m_userPoints;
+    return m_userImagePoints;
+
+}
+
+const std::vector<cv::Point2f>& PointManager::getUserMappingPoints() const {
+
+    return m_userMappingPoints;
+
+}
+
+const std::vector<PointManager::UserPointId>& PointManager::getUserPointIds() const {
+
+    return m_userPointIds;
+
+}
+
+std::size_t PointManager::getUserPointCount() const {
+
+    return m_userPointIds.size();
+
+}
+
+std::vector<PointManager::UserPoint> PointManager::getUserPoints() const {
+
+    std::vector<UserPoint> userPoints;
+
+    userPoints.reserve(m_userPointIds.size());
+
+    for (std::size_t i = 0; i < m_userPointIds.size(); i++)
+        userPoints.push_back({ m_userImagePoints[i], m_userMappingPoints[i], m_userPointIds[i] });
+
+    return userPoints;
 
 }
 
@@ -133,6 +165,32 @@ const cv::Size& PointManager::getWindowSize() const {
 
 }
 
+bool PointManager::setUserImagePoint(UserPointId id, cv::Point2f imagePoint) {
+
+    const int index = findUserPoint(id);
+
+    if (index < 0)
+        return false;
+
+    m_userImagePoints[index] = std::move(imagePoint);
+
+    return true;
+
+}
+
+bool PointManager::setUserMappingPoint(UserPointId id, cv::Point2f mappingPoint) {
+
+    const int index = findUserPoint(id);
+
+    if (index < 0)
+        return false;
+
+    m_userMappingPoints[index] = std::move(mappingPoint);
+
+    return true;
+
+}
+
 std::unique_ptr<PointManager> PointManager::createForBadminton( cv::Point2f scale, cv::Point2f offset) {
 
     std::vector<cv::Point2f> mappingPoints {
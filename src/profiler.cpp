@@ -0,0 +1,180 @@
+
+#include "profiler.hpp"
+
+#include <chrono>
+#include <iomanip>
+
+namespace {
+
+std::int64_t getTime() {
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+}
+
+// Threads are numbered in order of their first recorded event.
+std::uint32_t getThreadIndex() {
+
+    static std::atomic<std::uint32_t> threadCount { 0 };
+
+    thread_local std::uint32_t threadIndex = threadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    return threadIndex;
+
+}
+
+// Escapes characters, which are not allowed inside JSON string.
+void writeString(std::ostream& stream, const char* text) {
+
+    stream << '"';
+
+    for (const char* character = text ? text : ""; *character; character++) {
+
+        if (*character == '"' || *character == '\\') {
+            stream << '\\' << *character;
+        } else if (static_cast<unsigned char>(*character) >= 0x20) {
+            stream << *character;
+        }
+
+    }
+
+    stream << '"';
+
+}
+
+}
+
+Profiler::Profiler(std::size_t capacity)
+    : m_capacity { 1 }
+    , m_origin { getTime() }
+{
+
+    while (m_capacity < capacity)
+        m_capacity <<= 1;
+
+    m_slots = std::make_unique<Slot[]>(m_capacity);
+
+}
+
+std::uint64_t Profiler::beginFrame() {
+
+    return m_frame.fetch_add(1, std::memory_order_relaxed) + 1;
+
+}
+
+std::uint64_t Profiler::getFrame() const {
+
+    return m_frame.load(std::memory_order_relaxed);
+
+}
+
+std::int64_t Profiler::now() const {
+
+    return getTime() - m_origin;
+
+}
+
+void Profiler::record(const char* category, const char* name, std::uint64_t frame, std::int64_t start, std::int64_t duration) {
+
+    const std::uint64_t index = m_writeIndex.fetch_add(1, std::memory_order_relaxed);
+
+    Slot& slot = m_slots[index & (m_capacity - 1)];
+
+    // Odd sequence marks slot, which is being written.
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.frame.store(frame, std::memory_order_relaxed);
+    slot.thread.store(getThreadIndex(), std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.duration.store(duration, std::memory_order_relaxed);
+
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+}
+
+std::vector<Profiler::Event> Profiler::getEvents() const {
+
+    const std::uint64_t end = m_writeIndex.load(std::memory_order_acquire);
+    const std::uint64_t begin = end > m_capacity ? end - m_capacity : 0;
+
+    std::vector<Event> events;
+
+    events.reserve(end - begin);
+
+    for (std::uint64_t index = begin; index < end; index++) {
+
+        const Slot& slot = m_slots[index & (m_capacity - 1)];
+
+        if (slot.sequence.load(std::memory_order_acquire) != 2 * index + 2)
+            continue;
+
+        Event event {
+            slot.category.load(std::memory_order_relaxed),
+            slot.name.load(std::memory_order_relaxed),
+            slot.frame.load(std::memory_order_relaxed),
+            slot.thread.load(std::memory_order_relaxed),
+            slot.start.load(std::memory_order_relaxed),
+            slot.duration.load(std::memory_order_relaxed)
+        };
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Slot was overwritten while it was read.
+        if (slot.sequence.load(std::memory_order_relaxed) != 2 * index + 2)
+            continue;
+
+        events.push_back(event);
+
+    }
+
+    return events;
+
+}
+
+void Profiler::clear() {
+
+    const std::uint64_t end = m_writeIndex.load(std::memory_order_acquire);
+
+    for (std::size_t i = 0; i < m_capacity; i++)
+        m_slots[i].sequence.store(0, std::memory_order_relaxed);
+
+    // Events are not removed by resetting the write index, so a concurrent writer can not reuse sequence numbers.
+    m_writeIndex.store(end + m_capacity, std::memory_order_release);
+
+}
+
+void Profiler::writeChromeTrace(std::ostream& stream) const {
+
+    const std::vector<Event> events = getEvents();
+
+    // Timestamps are in microseconds, fixed notation keeps their precision in long traces.
+    const std::ios_base::fmtflags flags = stream.flags();
+    const std::streamsize precision = stream.precision();
+
+    stream << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+
+    for (std::size_t i = 0; i < events.size(); i++) {
+
+        const Event& event = events[i];
+
+        stream << (i ? ",\n" : "\n") << "{\"name\":";
+        writeString(stream, event.name);
+        stream << ",\"cat\":";
+        writeString(stream, event.category);
+        stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+               << ",\"ts\":" << event.start / 1000.0
+               << ",\"dur\":" << event.duration / 1000.0
+               << ",\"args\":{\"frame\":" << event.frame << "}}";
+
+    }
+
+    stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    stream.flags(flags);
+    stream.precision(precision);
+
+}
@@ -1,45 +1,317 @@
 
 #include "renderer.hpp"
 
+#include "homography.hpp"
 #include "utils.hpp"
 
 #include <opencv2/opencv.hpp>
 
 #include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Categories of profiler events recorded by renderer.
+constexpr const char* frameCategory = "frame";
+constexpr const char* stageCategory = "stage";
+constexpr const char* prepareCategory = "prepare";
+constexpr const char* drawCategory = "draw";
+
+// Union of rectangles, where empty rectangles are ignored.
+cv::Rect unite(const cv::Rect& first, const cv::Rect& second) {
+
+	if (first.empty())
+		return second;
+
+	return second.empty() ? first : first | second;
+
+}
+
+// OpenCV clips shapes to the image they are drawn into, which moves antialiased edges of the clipped
+// shapes. Drawables are therefore drawn whole and clipped only by the context, the same as in a full frame.
+cv::Rect extendCanvas(const cv::Rect& canvas, const cv::Rect& bounds, const cv::Rect& frame) {
+
+	if ((bounds & frame) != bounds)
+		return frame;
+
+	return canvas | bounds;
+
+}
+
+}
+
+Renderer::Renderer() {
+
+	addLayer(defaultLayerName, 0);
+
+	m_defaultLayer = m_layers.front().get();
+
+#if defined(IMAGECALIBRATIONLIBRARY_PROFILING)
+	m_profiler = std::make_unique<Profiler>();
+#endif
+
+}
 
 void Renderer::render() {
 
-	// Render the background image.
-    if(m_backgroundImage.empty()){
+	if (m_backgroundImage.empty())
+		return;
 
-        m_backgroundImage = m_context->getImage();
+	beginFrame();
 
-    }else{
+	IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, frameCategory, "render");
 
-     m_outputImage = m_backgroundImage.clone();
+	// Contexts could be resized by renderOnto.
+	reserveContext(m_backgroundImage.size());
 
-    }
+	m_drawables.compact();
+
+	assignDrawables();
+	prepareDrawables();
+
+	cv::Rect baseDamage;
+	cv::Rect staticDamage = updateStaticLayers(baseDamage);
+
+	if (!m_baseValid)
+		baseDamage = { 0, 0, m_size.width, m_size.height };
+
+	updateBaseImage(baseDamage);
+
+	if (m_damageTracking && !m_fullDamage) {
+		renderDamage(unite(staticDamage, baseDamage));
+	} else {
+		renderFull();
+	}
+
+	m_allocationStats.frameCount++;
+	m_allocationStats.frameAllocationCount = m_pendingAllocationCount;
+
+	m_pendingAllocationCount = 0;
+
+}
 
-	if (!m_context)
+void Renderer::renderOnto(cv::Mat frame, FrameFormat format) {
+
+	if (frame.empty())
 		return;
 
-	// Render the drawables.
-	m_context->clear();
+	cv::Size size = frame.size();
+
+	if (format == FrameFormat::BGR) {
+
+		if (frame.type() != CV_8UC3)
+			return;
+
+	} else {
+
+		if (frame.type() != CV_8UC1 || frame.rows % 3 != 0)
+			return;
+
+		size.height = frame.rows * 2 / 3;
+
+		if (size.width % 2 != 0 || size.height % 2 != 0 || (format == FrameFormat::I420 && !frame.isContinuous()))
+			return;
+
+	}
+
+	beginFrame();
+
+	IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, frameCategory, "renderOnto");
+
+	reserveContext(size);
+
+	m_drawables.compact();
+
+	assignDrawables();
+	prepareDrawables();
+
+	cv::Rect baseDamage;
+
+	updateStaticLayers(baseDamage);
+
+	// Base image is not used, it is updated by the next call of render.
+	if (!baseDamage.empty())
+		m_baseValid = false;
+
+	m_targetFrame = frame;
+	m_targetFormat = format;
+
+	const cv::Rect region(0, 0, size.width, size.height);
+
+	for (const std::unique_ptr<Layer>& layer : m_layers) {
+
+		if (layer->isStatic) {
+			composite(*layer->context, region, m_coveredTiles);
+			continue;
+		}
+
+		{
+			IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "clear");
+
+			layer->context->clear();
+		}
+
+		renderRegion(*layer, region);
 
-	for (std::unique_ptr<Drawable>& drawable : m_drawables) {
-		drawable->draw(*m_context);
 	}
 
-	// Overlay the output image with the resulting context.
-	blendImages(m_outputImage, m_context->getImage());
+	m_targetFrame.release();
+
+	// Output image does not match the context anymore.
+	m_fullDamage = true;
+
+	m_allocationStats.frameCount++;
+	m_allocationStats.frameAllocationCount = m_pendingAllocationCount;
+
+	m_pendingAllocationCount = 0;
 
 }
 
 Drawable* Renderer::addDrawable(std::unique_ptr<Drawable> drawable) {
 
-	m_drawables.emplace_back(std::move(drawable));
+	return m_drawables.get(insertDrawable(std::move(drawable)));
+
+}
+
+DrawableHandle Renderer::insertDrawable(std::unique_ptr<Drawable> drawable) {
+
+	return insertDrawable(std::move(drawable), defaultLayerName);
+
+}
+
+DrawableHandle Renderer::insertDrawable(std::unique_ptr<Drawable> drawable, const std::string& layer) {
+
+	Layer* target = findLayer(layer);
+
+	if (!target)
+		return {};
+
+	const DrawableHandle handle = m_drawables.insert(std::move(drawable));
+
+	if (handle.isNull())
+		return handle;
+
+	m_drawableLayers.resize(m_drawables.getSlotCount());
+	m_drawableLayers[handle.index] = target;
+
+	return handle;
+
+}
+
+bool Renderer::addLayer(const std::string& name, int order, bool isStatic) {
+
+	if (findLayer(name))
+		return false;
+
+	auto layer = std::make_unique<Layer>();
+
+	layer->name = name;
+	layer->order = order;
+	layer->isStatic = isStatic;
+
+	if (!m_size.empty())
+		reserveContext(*layer, m_size);
+
+	m_layers.push_back(std::move(layer));
+
+	sortLayers();
+
+	return true;
+
+}
+
+bool Renderer::removeLayer(const std::string& name) {
+
+	Layer* layer = findLayer(name);
+
+	if (!layer || layer == m_defaultLayer)
+		return false;
+
+	for (std::size_t i = 0; i < m_drawables.size(); i++) {
+
+		const DrawableHandle handle = m_drawables.getHandle(i);
+
+		if (!handle.isNull() && m_drawableLayers[handle.index] == layer)
+			m_drawables.remove(handle);
+
+	}
+
+	m_layers.erase(std::find_if(m_layers.begin(), m_layers.end(), [layer](const std::unique_ptr<Layer>& object) {
+
+		return object.get() == layer;
+
+	}));
+
+	sortLayers();
+
+	return true;
+
+}
+
+std::vector<std::string> Renderer::getLayerNames() const {
+
+	std::vector<std::string> names;
+
+	for (const std::unique_ptr<Layer>& layer : m_layers)
+		names.push_back(layer->name);
+
+	return names;
+
+}
+
+int Renderer::getLayerOrder(const std::string& name) const {
+
+	const Layer* layer = findLayer(name);
+
+	return layer ? layer->order : 0;
+
+}
+
+bool Renderer::setLayerOrder(const std::string& name, int order) {
+
+	Layer* layer = findLayer(name);
+
+	if (!layer)
+		return false;
+
+	if (layer->order != order) {
+		layer->order = order;
+		sortLayers();
+	}
+
+	return true;
+
+}
+
+bool Renderer::isLayerStatic(const std::string& name) const {
+
+	const Layer* layer = findLayer(name);
+
+	return layer && layer->isStatic;
+
+}
+
+bool Renderer::setLayerStatic(const std::string& name, bool isStatic) {
+
+	Layer* layer = findLayer(name);
+
+	if (!layer)
+		return false;
+
+	if (layer->isStatic != isStatic) {
+
+		layer->isStatic = isStatic;
+		layer->cached = false;
 
-	return m_drawables.back().get();
+		// Static layers are always premultiplied, so the context may have to be created again.
+		if (!m_size.empty())
+			reserveContext(*layer, m_size);
+
+		sortLayers();
+
+	}
+
+	return true;
 
 }
 
@@ -49,22 +321,207 @@ void Renderer::clearDrawables() {
 
 }
 
-std::vector<std::unique_ptr<Drawable>>& Renderer::getDrawables() {
+const std::vector<std::unique_ptr<Drawable>>& Renderer::getDrawables() {
+
+    return m_drawables.getDrawables();
+
+}
+
+Drawable* Renderer::getDrawable(DrawableHandle handle) const {
 
-    return m_drawables;
+	return m_drawables.get(handle);
+
+}
+
+DrawableHandle Renderer::getDrawableHandle(const Drawable* drawable) const {
+
+	return m_drawables.find(drawable);
 
 }
 
 void Renderer::removeDrawable(Drawable* drawable) {
 
-	auto iterator = std::find_if(m_drawables.begin(), m_drawables.end(), [drawable](const std::unique_ptr<Drawable>& object) {
+	removeDrawable(m_drawables.find(drawable));
 
-		return object.get() == drawable;
+}
 
-	});
+bool Renderer::removeDrawable(DrawableHandle handle) {
+
+	// Region of removed drawable is found from its damage record, the drawable itself is not needed.
+	return m_drawables.remove(handle) != nullptr;
+
+}
+
+std::int64_t Renderer::getDrawOrder(DrawableHandle handle) const {
+
+	return m_drawables.getOrder(handle);
+
+}
+
+bool Renderer::setDrawOrder(DrawableHandle handle, std::int64_t order) {
+
+	if (m_drawables.getOrder(handle) == order)
+		return m_drawables.contains(handle);
+
+	// Drawables overlapping the moved drawable have to be drawn again in the new order.
+	m_fullDamage = true;
+
+	for (const std::unique_ptr<Layer>& layer : m_layers)
+		layer->cached = false;
+
+	return m_drawables.setOrder(handle, order);
+
+}
+
+bool Renderer::getDamageTracking() const {
+
+	return m_damageTracking;
+
+}
+
+void Renderer::setDamageTracking(bool enabled) {
+
+	m_damageTracking = enabled;
+	m_fullDamage = true;
+
+	// Records of static layers are kept, they describe content of cached contexts.
+	for (const std::unique_ptr<Layer>& layer : m_layers) {
+
+		if (!layer->isStatic)
+			layer->damageRecords.clear();
+
+	}
+
+}
+
+bool Renderer::getParallelRendering() const {
+
+	return m_parallelRendering;
+
+}
+
+void Renderer::setParallelRendering(bool enabled) {
+
+	m_parallelRendering = enabled;
+
+}
+
+bool Renderer::getPremultipliedAlpha() const {
+
+	return m_premultipliedAlpha;
+
+}
+
+void Renderer::setPremultipliedAlpha(bool enabled) {
+
+	if (m_premultipliedAlpha == enabled)
+		return;
+
+	m_premultipliedAlpha = enabled;
+
+	if (!m_size.empty())
+		reserveContext(m_size);
+
+	m_fullDamage = true;
+
+}
+
+int Renderer::getTileSize() const {
+
+	return m_tileSize;
+
+}
 
-	if (iterator != m_drawables.end()) {
-		m_drawables.erase(iterator);
+void Renderer::setTileSize(int tileSize) {
+
+	// Even tiles keep 2x2 chroma blocks of YUV frames inside a single tile.
+	m_tileSize = std::max(tileSize, 16) & ~1;
+
+}
+
+const Renderer::AllocationStats& Renderer::getAllocationStats() const {
+
+	return m_allocationStats;
+
+}
+
+void Renderer::resetAllocationStats() {
+
+	m_allocationStats = {};
+	m_pendingAllocationCount = 0;
+
+}
+
+Renderer::Stats Renderer::getStats() const {
+
+	Stats stats;
+
+	stats.allocations = m_allocationStats;
+
+	if (!m_profiler)
+		return stats;
+
+	// Frame counter is increased when a frame starts, so the current frame is the last rendered one.
+	stats.frame = m_profiler->getFrame();
+
+	for (const Profiler::Event& event : m_profiler->getEvents()) {
+
+		if (event.frame != stats.frame)
+			continue;
+
+		const double milliseconds = event.duration / 1e6;
+
+		if (std::strcmp(event.category, frameCategory) == 0) {
+
+			stats.frameMilliseconds += milliseconds;
+
+		} else if (std::strcmp(event.category, stageCategory) == 0) {
+
+			auto stage = std::find_if(stats.stages.begin(), stats.stages.end(), [&event](const StageStats& stage) {
+
+				return std::strcmp(stage.name, event.name) == 0;
+
+			});
+
+			if (stage == stats.stages.end())
+				stage = stats.stages.insert(stats.stages.end(), StageStats { event.name });
+
+			stage->count++;
+			stage->milliseconds += milliseconds;
+
+		} else {
+
+			auto drawable = std::find_if(stats.drawables.begin(), stats.drawables.end(), [&event](const DrawableStats& drawable) {
+
+				return std::strcmp(drawable.typeName, event.name) == 0;
+
+			});
+
+			if (drawable == stats.drawables.end())
+				drawable = stats.drawables.insert(stats.drawables.end(), DrawableStats { event.name });
+
+			if (std::strcmp(event.category, prepareCategory) == 0) {
+				drawable->prepareCount++;
+				drawable->prepareMilliseconds += milliseconds;
+			} else {
+				drawable->drawCount++;
+				drawable->drawMilliseconds += milliseconds;
+			}
+
+		}
+
+	}
+
+	return stats;
+
+}
+
+void Renderer::writeChromeTrace(std::ostream& stream) const {
+
+	if (m_profiler) {
+		m_profiler->writeChromeTrace(stream);
+	} else {
+		stream << "{\"traceEvents\":[]}\n";
 	}
 
 }
@@ -77,7 +534,7 @@ cv::Mat Renderer::getBackgroundImage() const {
 
 cv::Mat Renderer::getOutputImage(bool includeBackground) const {
 
-	return includeBackground ? m_outputImage : m_context ? m_context->getImage() : cv::Mat(m_outputImage.rows, m_outputImage.cols, CV_8UC4, { 0, 0, 0, 255 });
+	return includeBackground ? m_outputImage : m_defaultLayer->context ? m_defaultLayer->context->getImage() : cv::Mat(m_outputImage.rows, m_outputImage.cols, CV_8UC4, { 0, 0, 0, 255 });
 
 }
 
@@ -87,11 +544,585 @@ void Renderer::setBackgroundImage(cv::Mat image) {
         return;
     }
 
-	m_backgroundImage.zeros(image.rows, image.cols, CV_8UC4);
-    m_outputImage.zeros(image.rows, image.cols, CV_8UC4);
+	reserveBuffer(m_backgroundImage, image.size(), CV_8UC4);
 
 	cv::cvtColor(image, m_backgroundImage, cv::COLOR_BGR2BGRA);
 
-	m_context = std::make_unique<Context>(cv::Size(image.cols, image.rows));
+	reserveContext(image.size());
+
+	m_fullDamage = true;
+	m_baseValid = false;
+
+}
+
+void Renderer::beginFrame() {
+
+	if (m_profiler)
+		m_profiler->beginFrame();
+
+}
+
+void Renderer::assignDrawables() {
+
+	for (const std::unique_ptr<Layer>& layer : m_layers)
+		layer->drawables.clear();
+
+	for (std::size_t i = 0; i < m_drawables.size(); i++)
+		m_drawableLayers[m_drawables.getHandle(i).index]->drawables.push_back(i);
+
+}
+
+Renderer::Layer* Renderer::findLayer(const std::string& name) const {
+
+	for (const std::unique_ptr<Layer>& layer : m_layers)
+		if (layer->name == name)
+			return layer.get();
+
+	return nullptr;
+
+}
+
+void Renderer::sortLayers() {
+
+	std::stable_sort(m_layers.begin(), m_layers.end(), [](const std::unique_ptr<Layer>& first, const std::unique_ptr<Layer>& second) {
+
+		return first->order < second->order;
+
+	});
+
+	// Static layers below all other layers are blended into base image.
+	m_baseLayerCount = 0;
+
+	while (m_baseLayerCount < m_layers.size() && m_layers[m_baseLayerCount]->isStatic)
+		m_baseLayerCount++;
+
+	m_baseValid = false;
+	m_fullDamage = true;
+
+}
+
+cv::Rect Renderer::updateStaticLayers(cv::Rect& baseDamage) {
+
+	IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "cache");
+
+	const cv::Rect frame(0, 0, m_size.width, m_size.height);
+
+	cv::Rect damage;
+
+	for (std::size_t i = 0; i < m_layers.size(); i++) {
+
+		Layer& layer = *m_layers[i];
+
+		if (!layer.isStatic)
+			continue;
+
+		// Records are updated even if the whole layer is drawn again.
+		cv::Rect layerDamage = findDamage(layer);
+
+		if (!layer.cached)
+			layerDamage = frame;
+
+		if (layerDamage.empty())
+			continue;
+
+		layer.context->clear(layerDamage);
+
+		// Drawables crossing the changed region are not clipped to it, so no seams stay in the cache.
+		renderRegion(layer, layerDamage, false);
+
+		layer.cached = true;
+
+		if (i < m_baseLayerCount) {
+			baseDamage = unite(baseDamage, layerDamage);
+		} else {
+			damage = unite(damage, layerDamage);
+		}
+
+	}
+
+	return damage;
+
+}
+
+void Renderer::updateBaseImage(cv::Rect damage) {
+
+	if (m_baseLayerCount == 0) {
+		m_baseValid = true;
+		return;
+	}
+
+	damage &= cv::Rect(0, 0, m_size.width, m_size.height);
+
+	if (damage.empty())
+		return;
+
+	IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "base");
+
+	reserveBuffer(m_baseImage, m_backgroundImage.size(), m_backgroundImage.type());
+
+	m_backgroundImage(damage).copyTo(m_baseImage(damage));
+
+	for (std::size_t i = 0; i < m_baseLayerCount; i++) {
+
+		const Context& context = *m_layers[i]->context;
+
+		context.getCoveredTiles(damage, m_coveredTiles);
+
+		for (const cv::Rect& tile : m_coveredTiles)
+			blendImages(m_baseImage(tile), context.getImage()(tile), context.isPremultiplied());
+
+	}
+
+	m_baseValid = true;
+
+}
+
+cv::Rect Renderer::findDamage(Layer& layer) {
+
+	IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "damage");
+
+	const cv::Rect frame(0, 0, m_size.width, m_size.height);
+
+	// Records are indexed by slot of drawable handle, the generation tells if the slot was reused.
+	std::swap(layer.damageRecords, layer.previousDamageRecords);
+
+	layer.damageRecords.assign(m_drawables.getSlotCount(), {});
+
+	cv::Rect damage;
+
+	auto addDamage = [&damage, &frame](const cv::Rect& rect) {
+
+		damage = unite(damage, rect & frame);
+
+	};
+
+	// Find regions of drawables, which were added or changed.
+	for (std::size_t position : layer.drawables) {
+
+		const Drawable& drawable = *m_drawables[position];
+		const DrawableHandle handle = m_drawables.getHandle(position);
+		const std::shared_ptr<Homography>& homography = drawable.getHomography();
+
+		DamageRecord record { drawable.getVersion(), homography ? homography->getVersion() : 0, drawable.getBounds() & frame, handle.generation };
+
+		DamageRecord* previous = handle.index < layer.previousDamageRecords.size() ? &layer.previousDamageRecords[handle.index] : nullptr;
+
+		if (!previous || previous->generation != handle.generation) {
+
+			addDamage(record.bounds);
+
+		} else {
+
+			if (previous->version != record.version || previous->homographyVersion != record.homographyVersion) {
+				addDamage(previous->bounds);
+				addDamage(record.bounds);
+			}
+
+			previous->generation = 0;
+
+		}
+
+		layer.damageRecords[handle.index] = record;
+
+	}
+
+	// Remaining records belong to removed drawables.
+	for (const DamageRecord& record : layer.previousDamageRecords) {
+
+		if (record.generation != 0)
+			addDamage(record.bounds);
+
+	}
+
+	return damage;
+
+}
+
+void Renderer::prepareDrawables() {
+
+	IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "prepare");
+
+	const cv::Size& size = m_size;
+
+	// Cost of drawables differs a lot, so every drawable is a separate stripe
+	// and idle threads pick up the remaining ones.
+	cv::parallel_for_(cv::Range(0, static_cast<int>(m_drawables.size())), [&](const cv::Range& range) {
+
+		for (int i = range.start; i < range.end; i++) {
+
+			IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, prepareCategory, m_drawables[i]->getTypeName());
+
+			m_drawables[i]->prepare(size);
+
+		}
+
+	}, static_cast<double>(m_drawables.size()));
+
+}
+
+void Renderer::reserveContext(const cv::Size& size) {
+
+	if (m_size != size)
+		m_baseValid = false;
+
+	m_size = size;
+
+	for (const std::unique_ptr<Layer>& layer : m_layers)
+		reserveContext(*layer, size);
+
+}
+
+void Renderer::reserveContext(Layer& layer, const cv::Size& size) {
+
+	// Cached layers are blended many times, so they always store premultiplied colors.
+	const bool premultiplied = layer.isStatic || m_premultipliedAlpha;
+
+	// Context is reused for frames of the same size.
+	if (layer.context && layer.context->getSize() == size && layer.context->isPremultiplied() == premultiplied)
+		return;
+
+	layer.context = std::make_unique<Context>(size, premultiplied);
+	layer.cached = false;
+
+	m_allocationStats.allocationCount++;
+	m_allocationStats.allocatedBytes += layer.context->getImage().total() * layer.context->getImage().elemSize();
+	m_pendingAllocationCount++;
+
+}
+
+void Renderer::composite(const Context& context, const cv::Rect& region, std::vector<cv::Rect>& tiles) {
+
+	IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "composite");
+
+	const cv::Mat overlay = context.getImage();
+	const bool premultiplied = context.isPremultiplied();
+
+	// Tiles, that were not covered by any drawable, are transparent and are skipped.
+	context.getCoveredTiles(region, tiles);
+
+	cv::parallel_for_(cv::Range(0, static_cast<int>(tiles.size())), [&](const cv::Range& range) {
+
+		for (int i = range.start; i < range.end; i++) {
+
+			const cv::Rect& tile = tiles[i];
+
+			if (m_targetFrame.empty()) {
+				blendImages(m_outputImage(tile), overlay(tile), premultiplied);
+				continue;
+			}
+
+			switch (m_targetFormat) {
+
+				case FrameFormat::BGR:
+
+					blendImages(m_targetFrame(tile), overlay(tile), premultiplied);
+					break;
+
+				case FrameFormat::NV12:
+
+					blendImagesNV12(m_targetFrame, overlay, tile, premultiplied);
+					break;
+
+				case FrameFormat::I420:
+
+					blendImagesI420(m_targetFrame, overlay, tile, premultiplied);
+					break;
+
+			}
+
+		}
+
+	});
+
+}
+
+void Renderer::reserveBuffer(cv::Mat& buffer, const cv::Size& size, int type) {
+
+	if (buffer.size() == size && buffer.type() == type)
+		return;
+
+	buffer.create(size, type);
+
+	m_allocationStats.allocationCount++;
+	m_allocationStats.allocatedBytes += buffer.total() * buffer.elemSize();
+	m_pendingAllocationCount++;
+
+}
+
+void Renderer::renderFull() {
+
+	const cv::Rect frame(0, 0, m_size.width, m_size.height);
+
+	// Render the background image, static layers below other layers are already blended into base image.
+	reserveBuffer(m_outputImage, m_backgroundImage.size(), m_backgroundImage.type());
+
+	{
+		IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "background");
+
+		(m_baseLayerCount ? m_baseImage : m_backgroundImage).copyTo(m_outputImage);
+	}
+
+	// Render the drawables and overlay the output image with the resulting contexts.
+	for (std::size_t i = m_baseLayerCount; i < m_layers.size(); i++) {
+
+		Layer& layer = *m_layers[i];
+
+		if (layer.isStatic) {
+			composite(*layer.context, frame, m_coveredTiles);
+			continue;
+		}
+
+		{
+			IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "clear");
+
+			layer.context->clear();
+		}
+
+		renderRegion(layer, frame);
+
+		if (m_damageTracking)
+			updateDamageRecords(layer);
+
+	}
+
+	if (m_damageTracking)
+		m_fullDamage = false;
+
+}
+
+void Renderer::renderDamage(const cv::Rect& staticDamage) {
+
+	cv::Rect damage = staticDamage;
+
+	for (std::size_t i = m_baseLayerCount; i < m_layers.size(); i++) {
+
+		if (!m_layers[i]->isStatic)
+			damage = unite(damage, findDamage(*m_layers[i]));
+
+	}
+
+	if (damage.empty())
+		return;
+
+	// Restore the background and redraw drawables inside the damaged region.
+	{
+		IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "background");
+
+		(m_baseLayerCount ? m_baseImage : m_backgroundImage)(damage).copyTo(m_outputImage(damage));
+	}
+
+	for (std::size_t i = m_baseLayerCount; i < m_layers.size(); i++) {
+
+		Layer& layer = *m_layers[i];
+
+		if (layer.isStatic) {
+			composite(*layer.context, damage, m_coveredTiles);
+			continue;
+		}
+
+		{
+			IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "clear");
+
+			layer.context->clear(damage);
+		}
+
+		renderRegion(layer, damage);
+
+	}
+
+}
+
+void Renderer::renderRegion(Layer& layer, const cv::Rect& region, bool blend) {
+
+	if (region.empty())
+		return;
+
+	Context& context = *layer.context;
+
+	// Bins are kept between frames, so binning does not allocate in steady state.
+	const int tileSize = m_tileSize;
+	const int columns = (region.width + tileSize - 1) / tileSize;
+	const int rows = (region.height + tileSize - 1) / tileSize;
+	const std::size_t tileCount = m_parallelRendering ? static_cast<std::size_t>(columns) * rows : 0;
+
+	if (m_tiles.size() < tileCount)
+		m_tiles.resize(tileCount);
+
+	for (std::size_t i = 0; i < tileCount; i++)
+		m_tiles[i].clear();
+
+	m_spanningDrawables.clear();
+
+	// Drawables inside a single tile are binned into the tile, the other ones are drawn once over the whole
+	// region after the tiles. Drawable inside a tile, which overlaps a spanning drawable drawn before it,
+	// starts a new batch, so the drawables are blended in the same order as by the serial rendering.
+	// Geometry was prepared in prepareDrawables, so drawing only reads state of drawables.
+	for (std::size_t position : layer.drawables) {
+
+		const cv::Rect bounds = m_drawables[position]->getBounds();
+
+		if ((bounds & region).empty())
+			continue;
+
+		const int column = (bounds.x - region.x) / tileSize;
+		const int row = (bounds.y - region.y) / tileSize;
+
+		const bool inside = tileCount != 0 && (bounds & region) == bounds
+			&& column == (bounds.x + bounds.width - 1 - region.x) / tileSize
+			&& row == (bounds.y + bounds.height - 1 - region.y) / tileSize;
+
+		if (!inside) {
+			m_spanningDrawables.push_back(position);
+			continue;
+		}
+
+		const bool overlaps = std::any_of(m_spanningDrawables.begin(), m_spanningDrawables.end(), [&](std::size_t spanning) {
+
+			return !(m_drawables[spanning]->getBounds() & bounds).empty();
+
+		});
+
+		if (overlaps)
+			drawBatch(context, region, columns, tileCount);
+
+		m_tiles[row * columns + column].push_back(position);
+
+	}
+
+	drawBatch(context, region, columns, tileCount);
+
+	if (blend)
+		composite(context, region, m_coveredTiles);
+
+}
+
+void Renderer::drawBatch(Context& context, const cv::Rect& region, int columns, std::size_t tileCount) {
+
+	const int tileSize = m_tileSize;
+
+	m_occupiedTiles.clear();
+
+	for (std::size_t i = 0; i < tileCount; i++)
+		if (!m_tiles[i].empty())
+			m_occupiedTiles.push_back(i);
+
+	// Drawables of a tile do not cross its border, so tiles are drawn directly into the context in parallel.
+	cv::parallel_for_(cv::Range(0, static_cast<int>(m_occupiedTiles.size())), [&](const cv::Range& range) {
+
+		for (int j = range.start; j < range.end; j++) {
+
+			const std::size_t i = m_occupiedTiles[j];
+			const cv::Rect tile = cv::Rect(region.x + static_cast<int>(i % columns) * tileSize, region.y + static_cast<int>(i / columns) * tileSize, tileSize, tileSize) & region;
+
+			IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "rasterize");
+
+			drawRegion(context, m_tiles[i], tile, tile, cv::Mat());
+
+		}
+
+	});
+
+	for (std::size_t i : m_occupiedTiles)
+		m_tiles[i].clear();
+
+	if (m_spanningDrawables.empty())
+		return;
+
+	{
+		IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, stageCategory, "rasterize");
+
+		const cv::Rect canvasRegion = findCanvas(m_spanningDrawables, region);
+
+		if (canvasRegion != region)
+			reserveCanvas(m_canvas, canvasRegion.size());
+
+		drawRegion(context, m_spanningDrawables, region, canvasRegion, m_canvas);
+	}
+
+	m_spanningDrawables.clear();
+
+}
+
+cv::Rect Renderer::findCanvas(const std::vector<std::size_t>& drawables, const cv::Rect& region) const {
+
+	const cv::Rect frame(0, 0, m_size.width, m_size.height);
+
+	cv::Rect canvas = region;
+
+	for (std::size_t position : drawables)
+		canvas = extendCanvas(canvas, m_drawables[position]->getBounds(), frame);
+
+	return canvas;
+
+}
+
+void Renderer::reserveCanvas(cv::Mat& canvas, const cv::Size& size) {
+
+	// Canvas only grows, so regions of different size reuse the same buffer.
+	if (canvas.cols >= size.width && canvas.rows >= size.height)
+		return;
+
+	reserveBuffer(canvas, { std::max(canvas.cols, size.width), std::max(canvas.rows, size.height) }, CV_8UC4);
+
+}
+
+void Renderer::drawRegion(Context& context, const std::vector<std::size_t>& drawables, const cv::Rect& region, const cv::Rect& canvasRegion, cv::Mat canvas) {
+
+	// No drawable crosses border of the region, so they can be drawn into the context directly.
+	if (canvasRegion == region) {
+
+		Context view(context, region);
+
+		for (std::size_t position : drawables) {
+
+			IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, drawCategory, m_drawables[position]->getTypeName());
+
+			view.draw(*m_drawables[position]);
+
+		}
+
+		return;
+
+	}
+
+	// Pixels of the canvas outside of the region are never copied back, so only the region is initialized.
+	cv::Mat image = canvas(cv::Rect(0, 0, canvasRegion.width, canvasRegion.height));
+	cv::Mat target = image(region - canvasRegion.tl());
+
+	context.getImage()(region).copyTo(target);
+
+	Context view(context, canvasRegion, image);
+
+	for (std::size_t position : drawables) {
+
+		Drawable& drawable = *m_drawables[position];
+
+		IMAGECALIBRATIONLIBRARY_PROFILE_SCOPE(*m_profiler, drawCategory, drawable.getTypeName());
+
+		view.draw(drawable);
+
+		context.markCovered(drawable.getBounds() & region);
+
+	}
+
+	target.copyTo(context.getImage()(region));
+
+}
+
+void Renderer::updateDamageRecords(Layer& layer) {
+
+	const cv::Rect frame(0, 0, m_size.width, m_size.height);
+
+	layer.damageRecords.assign(m_drawables.getSlotCount(), {});
+
+	for (std::size_t position : layer.drawables) {
+
+		const Drawable& drawable = *m_drawables[position];
+		const DrawableHandle handle = m_drawables.getHandle(position);
+		const std::shared_ptr<Homography>& homography = drawable.getHomography();
+
+		layer.damageRecords[handle.index] = { drawable.getVersion(), homography ? homography->getVersion() : 0, drawable.getBounds() & frame, handle.generation };
+
+	}
 
 }
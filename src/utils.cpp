@@ -4,19 +4,462 @@
 #include "homography.hpp"
 #include "pointManager.hpp"
 
-void blendImages(cv::Mat destinationImage, cv::Mat sourceImage) {
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-	for (int x = 0; x < destinationImage.cols; x++)
-		for (int y = 0; y < destinationImage.rows; y++) {
-			auto& destination = destinationImage.at<cv::Vec4b>(y, x);
-			auto& source = sourceImage.at<cv::Vec4b>(y, x);
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
 
-			float alpha = source[3] / 255.0f;
+namespace {
 
-			// Merge the color channels.
-			for (int i = 0; i < 4; i++)
-				destination[i] = static_cast<uchar>((1.0 - alpha) * destination[i] + alpha * source[i]);
-		}
+// Fixed-point equivalent of (1 - a) * destination + a * source with a = alpha / 255.
+// The division by 255 is approximated by (t + 1 + (t >> 8)) >> 8, which stays
+// within one LSB of the floating point version for every input combination.
+inline uchar blendChannel(uint destination, uint source, uint alpha) {
+
+    uint t = destination * (255 - alpha) + source * alpha;
+
+    return static_cast<uchar>((t + 1 + (t >> 8)) >> 8);
+
+}
+
+// Fixed-point equivalent of source + (1 - a) * destination for premultiplied source.
+inline uchar blendChannelPremultiplied(uint destination, uint source, uint alpha) {
+
+    uint t = destination * (255 - alpha);
+
+    return static_cast<uchar>(std::min(source + ((t + 1 + (t >> 8)) >> 8), 255u));
+
+}
+
+template<bool premultiplied>
+inline uchar blendChannel(uint destination, uint source, uint alpha) {
+
+    return premultiplied ? blendChannelPremultiplied(destination, source, alpha) : blendChannel(destination, source, alpha);
+
+}
+
+// Blends pixels [begin, end) of a single row with the scalar kernel.
+template<bool premultiplied>
+void blendRowScalar(uchar* destination, const uchar* source, int begin, int end) {
+
+    for (int x = begin; x < end; x++) {
+
+        const uchar* s = source + 4 * x;
+        uchar* d = destination + 4 * x;
+
+        uint alpha = s[3];
+
+        // Fully transparent pixels leave the destination untouched.
+        if (alpha == 0)
+            continue;
+
+        if (alpha == 255) {
+            d[0] = s[0];
+            d[1] = s[1];
+            d[2] = s[2];
+            d[3] = s[3];
+            continue;
+        }
+
+        for (int i = 0; i < 4; i++)
+            d[i] = blendChannel<premultiplied>(d[i], s[i], alpha);
+
+    }
+
+}
+
+// Returns true if all four pixels starting at source are fully transparent.
+inline bool isTransparent(const uchar* source) {
+
+    std::uint32_t pixels[4];
+
+    std::memcpy(pixels, source, sizeof(pixels));
+
+    return ((pixels[0] | pixels[1] | pixels[2] | pixels[3]) & 0xFF000000u) == 0;
+
+}
+
+// Blends single row of BGRA source into BGR destination.
+template<bool premultiplied>
+void blendRowBGR(uchar* destination, const uchar* source, int width) {
+
+    int x = 0;
+
+    while (x < width) {
+
+        // Skip spans of fully transparent source pixels.
+        if (x + 4 <= width && isTransparent(source + 4 * x)) {
+            x += 4;
+            continue;
+        }
+
+        for (int end = std::min(x + 4, width); x < end; x++) {
+
+            const uchar* s = source + 4 * x;
+            uchar* d = destination + 3 * x;
+
+            uint alpha = s[3];
+
+            if (alpha == 0)
+                continue;
+
+            if (alpha == 255) {
+                d[0] = s[0];
+                d[1] = s[1];
+                d[2] = s[2];
+                continue;
+            }
+
+            for (int i = 0; i < 3; i++)
+                d[i] = blendChannel<premultiplied>(d[i], s[i], alpha);
+
+        }
+
+    }
+
+}
+
+// Pointers to planes of YUV 4:2:0 frame, chroma samples of one plane are
+// chromaPixelStep bytes apart, which is 2 for NV12 and 1 for I420.
+struct YUVPlanes {
+
+    uchar* luma;
+
+    std::size_t lumaStep;
+
+    uchar* u;
+
+    uchar* v;
+
+    std::size_t chromaStep;
+
+    int chromaPixelStep;
+
+};
+
+// Blends BGRA source into YUV frame, region has to start and end at even coordinates.
+// Colors are converted with BT.601 limited range coefficients used by OpenCV for YUV 4:2:0.
+void blendYUV(const YUVPlanes& planes, const cv::Mat& source, const cv::Rect& region, bool premultiplied) {
+
+    cv::parallel_for_(cv::Range(region.y / 2, (region.y + region.height) / 2), [&](const cv::Range& range) {
+
+        for (int row = range.start; row < range.end; row++) {
+
+            const uchar* sourceRows[2] = { source.ptr<uchar>(2 * row), source.ptr<uchar>(2 * row + 1) };
+
+            uchar* lumaRows[2] = { planes.luma + 2 * row * planes.lumaStep, planes.luma + (2 * row + 1) * planes.lumaStep };
+
+            uchar* u = planes.u + row * planes.chromaStep;
+            uchar* v = planes.v + row * planes.chromaStep;
+
+            for (int column = region.x / 2; column < (region.x + region.width) / 2; column++) {
+
+                // Block of 2x2 pixels shares one chroma sample.
+                if (((sourceRows[0][8 * column + 3] | sourceRows[0][8 * column + 7]
+                    | sourceRows[1][8 * column + 3] | sourceRows[1][8 * column + 7])) == 0)
+                    continue;
+
+                int alphaSum = 0;
+                int uSum = 0;
+                int vSum = 0;
+
+                for (int i = 0; i < 2; i++)
+                    for (int j = 0; j < 2; j++) {
+
+                        const uchar* s = sourceRows[i] + 4 * (2 * column + j);
+
+                        uint alpha = s[3];
+
+                        if (alpha == 0)
+                            continue;
+
+                        int b = s[0];
+                        int g = s[1];
+                        int r = s[2];
+
+                        // Luma offset does not scale with alpha, so premultiplied colors are restored first.
+                        if (premultiplied && alpha < 255) {
+                            b = std::min(255u, (b * 255 + alpha / 2) / alpha);
+                            g = std::min(255u, (g * 255 + alpha / 2) / alpha);
+                            r = std::min(255u, (r * 255 + alpha / 2) / alpha);
+                        }
+
+                        uint luma = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+
+                        uchar& destination = lumaRows[i][2 * column + j];
+
+                        destination = blendChannel(destination, luma, alpha);
+
+                        alphaSum += alpha;
+                        uSum += alpha * (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                        vSum += alpha * (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+
+                    }
+
+                // Chroma is blended with the mean alpha of the block.
+                uchar& chromaU = u[column * planes.chromaPixelStep];
+                uchar& chromaV = v[column * planes.chromaPixelStep];
+
+                chromaU = static_cast<uchar>((chromaU * (1020 - alphaSum) + uSum + 510) / 1020);
+                chromaV = static_cast<uchar>((chromaV * (1020 - alphaSum) + vSum + 510) / 1020);
+
+            }
+
+        }
+
+    }, std::max(1.0, region.height / 128.0));
+
+}
+
+// Checks the YUV frame and returns region of the image aligned to chroma samples.
+bool prepareYUVRegion(const cv::Mat& frame, const cv::Mat& sourceImage, cv::Rect& region) {
+
+    if (frame.empty() || frame.type() != CV_8UC1 || frame.rows % 3 != 0 || sourceImage.type() != CV_8UC4)
+        return false;
+
+    const cv::Size size(frame.cols, frame.rows * 2 / 3);
+
+    if (size.width % 2 != 0 || size.height % 2 != 0 || sourceImage.size() != size)
+        return false;
+
+    if (region.empty())
+        region = { 0, 0, size.width, size.height };
+
+    const int left = region.x & ~1;
+    const int top = region.y & ~1;
+
+    region = cv::Rect(left, top, ((region.x + region.width + 1) & ~1) - left, ((region.y + region.height + 1) & ~1) - top)
+           & cv::Rect(0, 0, size.width, size.height);
+
+    return !region.empty();
+
+}
+
+#if defined(__AVX2__)
+
+// Blends 8 pixels at a time, returns the index of the first pixel that was not processed.
+template<bool premultiplied>
+int blendRowSimd(uchar* destination, const uchar* source, int width) {
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i full = _mm256_set1_epi16(255);
+    const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 4 * x));
+
+        // Skip spans of fully transparent source pixels.
+        if (_mm256_testz_si256(s, alphaMask))
+            continue;
+
+        __m256i* target = reinterpret_cast<__m256i*>(destination + 4 * x);
+
+        // Fully opaque spans are a plain copy.
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(s, alphaMask), alphaMask)) == -1) {
+            _mm256_storeu_si256(target, s);
+            continue;
+        }
+
+        __m256i d = _mm256_loadu_si256(target);
+
+        __m256i sLow = _mm256_unpacklo_epi8(s, zero);
+        __m256i sHigh = _mm256_unpackhi_epi8(s, zero);
+        __m256i dLow = _mm256_unpacklo_epi8(d, zero);
+        __m256i dHigh = _mm256_unpackhi_epi8(d, zero);
+
+        // Broadcast alpha of each pixel into all four of its 16-bit channels.
+        __m256i aLow = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sLow, 0xFF), 0xFF);
+        __m256i aHigh = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sHigh, 0xFF), 0xFF);
+
+        __m256i tLow = _mm256_mullo_epi16(dLow, _mm256_sub_epi16(full, aLow));
+        __m256i tHigh = _mm256_mullo_epi16(dHigh, _mm256_sub_epi16(full, aHigh));
+
+        // Premultiplied source is added after the division, straight source is weighted by alpha.
+        if (!premultiplied) {
+            tLow = _mm256_add_epi16(tLow, _mm256_mullo_epi16(sLow, aLow));
+            tHigh = _mm256_add_epi16(tHigh, _mm256_mullo_epi16(sHigh, aHigh));
+        }
+
+        tLow = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(tLow, one), _mm256_srli_epi16(tLow, 8)), 8);
+        tHigh = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(tHigh, one), _mm256_srli_epi16(tHigh, 8)), 8);
+
+        __m256i result = _mm256_packus_epi16(tLow, tHigh);
+
+        if (premultiplied)
+            result = _mm256_adds_epu8(result, s);
+
+        _mm256_storeu_si256(target, result);
+
+    }
+
+    return x;
+
+}
+
+#elif defined(__SSE2__)
+
+// Blends 4 pixels at a time, returns the index of the first pixel that was not processed.
+template<bool premultiplied>
+int blendRowSimd(uchar* destination, const uchar* source, int width) {
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 4 * x));
+        __m128i sAlpha = _mm_and_si128(s, alphaMask);
+
+        // Skip spans of fully transparent source pixels.
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(sAlpha, zero)) == 0xFFFF)
+            continue;
+
+        __m128i* target = reinterpret_cast<__m128i*>(destination + 4 * x);
+
+        // Fully opaque spans are a plain copy.
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(sAlpha, alphaMask)) == 0xFFFF) {
+            _mm_storeu_si128(target, s);
+            continue;
+        }
+
+        __m128i d = _mm_loadu_si128(target);
+
+        __m128i sLow = _mm_unpacklo_epi8(s, zero);
+        __m128i sHigh = _mm_unpackhi_epi8(s, zero);
+        __m128i dLow = _mm_unpacklo_epi8(d, zero);
+        __m128i dHigh = _mm_unpackhi_epi8(d, zero);
+
+        // Broadcast alpha of each pixel into all four of its 16-bit channels.
+        __m128i aLow = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLow, 0xFF), 0xFF);
+        __m128i aHigh = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHigh, 0xFF), 0xFF);
+
+        __m128i tLow = _mm_mullo_epi16(dLow, _mm_sub_epi16(full, aLow));
+        __m128i tHigh = _mm_mullo_epi16(dHigh, _mm_sub_epi16(full, aHigh));
+
+        // Premultiplied source is added after the division, straight source is weighted by alpha.
+        if (!premultiplied) {
+            tLow = _mm_add_epi16(tLow, _mm_mullo_epi16(sLow, aLow));
+            tHigh = _mm_add_epi16(tHigh, _mm_mullo_epi16(sHigh, aHigh));
+        }
+
+        tLow = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(tLow, one), _mm_srli_epi16(tLow, 8)), 8);
+        tHigh = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(tHigh, one), _mm_srli_epi16(tHigh, 8)), 8);
+
+        __m128i result = _mm_packus_epi16(tLow, tHigh);
+
+        if (premultiplied)
+            result = _mm_adds_epu8(result, s);
+
+        _mm_storeu_si128(target, result);
+
+    }
+
+    return x;
+
+}
+
+#else
+
+template<bool premultiplied>
+int blendRowSimd(uchar*, const uchar*, int) {
+
+    return 0;
+
+}
+
+#endif
+
+}
+
+void blendImages(cv::Mat destinationImage, cv::Mat sourceImage, bool premultiplied) {
+
+    if (destinationImage.empty() || destinationImage.size() != sourceImage.size()
+            || (destinationImage.type() != CV_8UC4 && destinationImage.type() != CV_8UC3) || sourceImage.type() != CV_8UC4)
+        return;
+
+    const int width = destinationImage.cols;
+
+    if (destinationImage.type() == CV_8UC3) {
+
+        cv::parallel_for_(cv::Range(0, destinationImage.rows), [&](const cv::Range& range) {
+
+            for (int y = range.start; y < range.end; y++) {
+
+                if (premultiplied) {
+                    blendRowBGR<true>(destinationImage.ptr<uchar>(y), sourceImage.ptr<uchar>(y), width);
+                } else {
+                    blendRowBGR<false>(destinationImage.ptr<uchar>(y), sourceImage.ptr<uchar>(y), width);
+                }
+
+            }
+
+        }, std::max(1.0, destinationImage.rows / 64.0));
+
+        return;
+
+    }
+
+    // Rows are split into bands, which are blended in parallel.
+    cv::parallel_for_(cv::Range(0, destinationImage.rows), [&](const cv::Range& range) {
+
+        for (int y = range.start; y < range.end; y++) {
+
+            uchar* destination = destinationImage.ptr<uchar>(y);
+            const uchar* source = sourceImage.ptr<uchar>(y);
+
+            if (premultiplied) {
+                blendRowScalar<true>(destination, source, blendRowSimd<true>(destination, source, width), width);
+            } else {
+                blendRowScalar<false>(destination, source, blendRowSimd<false>(destination, source, width), width);
+            }
+
+        }
+
+    }, std::max(1.0, destinationImage.rows / 64.0));
+
+}
+
+void blendImagesNV12(cv::Mat frame, cv::Mat sourceImage, cv::Rect region, bool premultiplied) {
+
+    if (!prepareYUVRegion(frame, sourceImage, region))
+        return;
+
+    const int height = frame.rows * 2 / 3;
+
+    uchar* chroma = frame.ptr<uchar>(height);
+
+    blendYUV({ frame.data, frame.step, chroma, chroma + 1, frame.step, 2 }, sourceImage, region, premultiplied);
+
+}
+
+void blendImagesI420(cv::Mat frame, cv::Mat sourceImage, cv::Rect region, bool premultiplied) {
+
+    // Chroma planes of I420 are packed without row padding, so the frame has to be continuous.
+    if (!frame.isContinuous() || !prepareYUVRegion(frame, sourceImage, region))
+        return;
+
+    const std::size_t width = frame.cols;
+    const std::size_t height = frame.rows * 2 / 3;
+
+    uchar* u = frame.data + width * height;
+    uchar* v = u + (width / 2) * (height / 2);
+
+    blendYUV({ frame.data, width, u, v, width / 2, 1 }, sourceImage, region, premultiplied);
 
 }
 
@@ -56,35 +499,115 @@ cv::Mat computeBirdsEyeView(cv::Mat homography, cv::Mat image, const cv::Size& w
 
 }
 
-cv::Mat undistort(cv::Mat input, double k, double scale){
+cv::Mat computeBirdsEyeView(const Homography& homography, cv::Mat image, const cv::Size& windowSize) {
+
+    return homography.warpImage(image, windowSize);
+
+}
+
+cv::Mat computeUndistortMap(const cv::Size& size, double k, double scale) {
+
+    cv::Mat map(size, CV_16SC2);
+
+    double midX = size.width/2;
+    double midY = size.height/2;
 
-    cv::Mat undistortedImage(input.rows, input.cols, input.type(),cv::Scalar(0,0,0));
+    cv::parallel_for_(cv::Range(0, size.height), [&](const cv::Range& range) {
 
-    double r;
+        for (int y = range.start; y < range.end; y++) {
 
-    double undistX,undistY;
+            cv::Vec2s* row = map.ptr<cv::Vec2s>(y);
 
-    double midX = input.cols/2;
-    double midY = input.rows/2;
+            double dy = y - midY;
 
-    for(int x = 0; x < input.cols; x++){
+            for (int x = 0; x < size.width; x++) {
 
-        for(int y = 0; y < input.rows; y++){
+                double dx = x - midX;
 
-            r = std::pow((x-midX),2) + std::pow((y-midY),2);
+                double r = dx * dx + dy * dy;
 
-            undistX = ((x-midX))/(1 - k*r)*scale;
-            undistY = ((y-midY))/(1 - k*r)*scale;
+                double undistX = dx / (1 - k * r) * scale + midX;
+                double undistY = dy / (1 - k * r) * scale + midY;
+
+                // Pixels, that are mapped outside of the input image, point to
+                // coordinate outside of the image and remain black after remap.
+                if (std::round(undistX) >= 0 && std::round(undistY) >= 0 && std::round(undistX) < size.width && std::round(undistY) < size.height) {
+                    row[x] = { static_cast<short>(undistX), static_cast<short>(undistY) };
+                } else {
+                    row[x] = { -1, -1 };
+                }
 
-            if ( std::round(undistX+midX) >= 0 && std::round(undistY+midY) >= 0 && std::round(undistX+midX) < input.cols && std::round(undistY+midY) < input.rows ){
-            undistortedImage.at<cv::Vec3b>(y,x) = input.at<cv::Vec3b>(undistY+midY,undistX+midX);
             }
 
+        }
+
+    });
+
+    return map;
+
+}
+
+cv::Mat undistort(cv::Mat input, double k, double scale){
+
+    cv::Mat undistortedImage;
+
+    undistort(input, undistortedImage, k, scale);
+
+    return undistortedImage;
+
+}
+
+void undistort(cv::Mat input, cv::Mat& output, double k, double scale) {
+
+    if (input.empty())
+        return;
+
+    // Maps of the last few cameras are cached, since k, scale and
+    // size of the image usually stay the same for the whole video.
+    struct UndistortMap {
+
+        cv::Size size;
+
+        double k;
+
+        double scale;
+
+        cv::Mat map;
+
+    };
+
+    static std::mutex mutex;
+    static std::vector<UndistortMap> maps;
+
+    cv::Mat map;
+
+    {
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto iterator = std::find_if(maps.begin(), maps.end(), [&](const UndistortMap& cached) {
+
+            return cached.size == input.size() && cached.k == k && cached.scale == scale;
+
+        });
+
+        if (iterator != maps.end()) {
+
+            map = iterator->map;
+
+        } else {
+
+            map = computeUndistortMap(input.size(), k, scale);
+
+            if (maps.size() >= 4)
+                maps.erase(maps.begin());
+
+            maps.push_back({ input.size(), k, scale, map });
 
         }
 
     }
 
-    return undistortedImage;
+    cv::remap(input, output, map, cv::noArray(), cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar::all(0));
 
 }
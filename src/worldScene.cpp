@@ -0,0 +1,171 @@
+
+#include "worldScene.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Maximum length of a single circle segment in mapping plane.
+constexpr float maxSegmentLength = 2.0f;
+
+// Minimum and maximum number of contour points of a single circle.
+constexpr int minSamples = 8;
+constexpr int maxSamples = 256;
+
+}
+
+std::size_t WorldScene::addCircle(cv::Point2f center, float radius, cv::Scalar color, int thickness, float alpha) {
+
+    int samples = 0;
+
+    if (radius > 0.0f && std::isfinite(radius))
+        samples = std::clamp(static_cast<int>(std::ceil(2.0 * CV_PI * radius / maxSegmentLength)), minSamples, maxSamples);
+
+    Shape shape;
+
+    shape.position = center;
+    shape.color = color;
+    shape.alpha = alpha;
+    shape.thickness = thickness;
+    shape.closed = true;
+    shape.begin = m_localPoints.size();
+
+    for (int i = 0; i < samples; i++) {
+
+        const float angle = static_cast<float>(2.0 * CV_PI * i / samples);
+
+        m_localPoints.emplace_back(radius * std::cos(angle), radius * std::sin(angle));
+
+    }
+
+    shape.end = m_localPoints.size();
+
+    return addShape(shape);
+
+}
+
+std::size_t WorldScene::addPolyline(const std::vector<cv::Point2f>& points, bool closed, cv::Scalar color, int thickness, float alpha) {
+
+    Shape shape;
+
+    shape.color = color;
+    shape.alpha = alpha;
+    shape.thickness = thickness;
+    shape.closed = closed;
+    shape.begin = m_localPoints.size();
+
+    m_localPoints.insert(m_localPoints.end(), points.begin(), points.end());
+
+    shape.end = m_localPoints.size();
+
+    return addShape(shape);
+
+}
+
+void WorldScene::clear() {
+
+    m_shapes.clear();
+    m_localPoints.clear();
+    m_version++;
+
+}
+
+const std::vector<cv::Point2f>& WorldScene::getPoints() const {
+
+    return m_points;
+
+}
+
+cv::Point2f WorldScene::getPosition(std::size_t shape) const {
+
+    return shape < m_shapes.size() ? m_shapes[shape].position : cv::Point2f {};
+
+}
+
+std::size_t WorldScene::getShapeCount() const {
+
+    return m_shapes.size();
+
+}
+
+const std::vector<WorldScene::Shape>& WorldScene::getShapes() const {
+
+    return m_shapes;
+
+}
+
+std::uint64_t WorldScene::getVersion() const {
+
+    return m_version;
+
+}
+
+void WorldScene::prepare() {
+
+    // Views of different cameras prepare their geometry concurrently, the first one computes the points.
+    std::lock_guard<std::mutex> lock { m_mutex };
+
+    if (m_preparedVersion == m_version)
+        return;
+
+    m_points.resize(m_localPoints.size());
+
+    for (const Shape& shape : m_shapes)
+        for (std::size_t i = shape.begin; i < shape.end; i++)
+            m_points[i] = m_localPoints[i] + shape.position;
+
+    m_preparedVersion = m_version;
+
+}
+
+void WorldScene::setAlpha(std::size_t shape, float alpha) {
+
+    if (shape >= m_shapes.size())
+        return;
+
+    m_shapes[shape].alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+    m_version++;
+
+}
+
+void WorldScene::setColor(std::size_t shape, cv::Scalar color) {
+
+    if (shape >= m_shapes.size())
+        return;
+
+    m_shapes[shape].color = color;
+    m_version++;
+
+}
+
+void WorldScene::setPosition(std::size_t shape, cv::Point2f position) {
+
+    setPositions(&position, 1, shape);
+
+}
+
+void WorldScene::setPositions(const cv::Point2f* positions, std::size_t count, std::size_t first) {
+
+    if (first >= m_shapes.size())
+        return;
+
+    count = std::min(count, m_shapes.size() - first);
+
+    for (std::size_t i = 0; i < count; i++)
+        m_shapes[first + i].position = positions[i];
+
+    m_version++;
+
+}
+
+std::size_t WorldScene::addShape(Shape shape) {
+
+    shape.alpha = std::min(std::max(shape.alpha, 0.0f), 1.0f);
+
+    m_shapes.push_back(shape);
+    m_version++;
+
+    return m_shapes.size() - 1;
+
+}